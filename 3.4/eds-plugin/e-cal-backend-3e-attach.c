@@ -21,6 +21,7 @@
  */
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include "e-cal-backend-3e-priv.h"
 
 typedef struct _attachment attachment;
@@ -32,6 +33,9 @@ struct _attachment
     char *filename;
     gboolean is_on_server;  /**< Attachment is known to be stored on the server. */
     gboolean is_in_cache;   /**< Attachment is known to be stored locally. */
+    time_t last_access;     /**< Last time the local copy was used (for LRU eviction). */
+    goffset size;           /**< Size of the local copy in bytes, -1 if unknown. */
+    gboolean is_downloading; /**< Download of the local copy is in progress. */
 };
 
 static void attachment_free(attachment *a)
@@ -43,6 +47,44 @@ static void attachment_free(attachment *a)
     g_free(a);
 }
 
+static attachment *attachment_copy(attachment *a)
+{
+    attachment *copy = g_new0(attachment, 1);
+
+    copy->eee_uri = g_strdup(a->eee_uri);
+    copy->local_uri = g_strdup(a->local_uri);
+    copy->sha1 = g_strdup(a->sha1);
+    copy->filename = g_strdup(a->filename);
+    copy->is_on_server = a->is_on_server;
+    copy->is_in_cache = a->is_in_cache;
+    copy->last_access = a->last_access;
+    copy->size = a->size;
+
+    return copy;
+}
+
+static void attachment_touch(attachment *a)
+{
+    a->last_access = time(NULL);
+}
+
+static goffset attachment_get_size(attachment *a)
+{
+    if (a->size < 0)
+    {
+        char *path = g_filename_from_uri(a->local_uri, NULL, NULL);
+        struct stat st;
+
+        if (path && g_stat(path, &st) == 0)
+        {
+            a->size = st.st_size;
+        }
+        g_free(path);
+    }
+
+    return MAX(a->size, 0);
+}
+
 static char *checksum_file(GFile *file)
 {
     char buf[4096];
@@ -65,14 +107,14 @@ static char *checksum_file(GFile *file)
     return result;
 }
 
-static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const char *uri)
+/* Find attachment in the store, caller must hold attachments_mutex. */
+static attachment *find_attachment(ECalBackend3e *cb, const char *uri)
 {
     GSList *iter;
-    attachment *a;
 
     for (iter = cb->priv->attachments; iter; iter = iter->next)
     {
-        a = iter->data;
+        attachment *a = iter->data;
 
         if (!g_ascii_strcasecmp(a->local_uri, uri) || !g_ascii_strcasecmp(a->eee_uri, uri))
         {
@@ -80,7 +122,22 @@ static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const
         }
     }
 
-    a = NULL;
+    return NULL;
+}
+
+static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const char *uri)
+{
+    attachment *a;
+
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
+    a = find_attachment(cb, uri);
+    if (a)
+    {
+        attachment_touch(a);
+        g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+        return a;
+    }
 
     if (g_str_has_prefix(uri, "eee://"))
     {
@@ -92,6 +149,7 @@ static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const
         if (g_strv_length(parts) == 4)
         {
             a = g_new0(attachment, 1);
+            a->size = -1;
             a->eee_uri = g_strdup(uri);
             a->local_uri = g_strdup_printf("file://%s/%s-%s", e_cal_backend_3e_get_cache_path(cb), uid, parts[3]);
             a->sha1 = g_strdup(parts[2]);
@@ -119,6 +177,7 @@ static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const
         }
 
         a = g_new0(attachment, 1);
+        a->size = -1;
         a->filename = g_strdup(filename);
         a->sha1 = sha1;
         a->local_uri = g_strdup(uri);
@@ -132,10 +191,13 @@ static attachment *get_attacmhent(ECalBackend3e *cb, ECalComponent *comp, const
 
     if (a)
     {
+        attachment_touch(a);
         cb->priv->attachments = g_slist_append(cb->priv->attachments, a);
         e_cal_backend_3e_attachment_store_save(cb);
     }
 
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+
     return a;
 }
 
@@ -257,6 +319,66 @@ static gboolean upload_attachment(ECalBackend3e *cb, attachment *att, GError * *
     return retval;
 }
 
+/* Ask the server which of the given attachments it already stores and update
+ * their is_on_server flags accordingly. Attachments are content-addressed by
+ * SHA-1, so a blob uploaded by anyone else does not need to be sent again.
+ *
+ * Servers that do not implement hasAttachments() are handled by leaving the
+ * flags cleared, which makes the caller upload everything as before.
+ */
+static void query_attachments_on_server(ECalBackend3e *cb, GSList *attachments)
+{
+    GError *local_err = NULL;
+    GSList *sha1s = NULL;
+    GSList *present;
+    GSList *iter;
+    gboolean changed = FALSE;
+
+    for (iter = attachments; iter; iter = iter->next)
+    {
+        attachment *a = iter->data;
+
+        a->is_on_server = FALSE;
+        if (a->sha1)
+        {
+            sha1s = g_slist_append(sha1s, a->sha1);
+        }
+    }
+
+    if (sha1s == NULL)
+    {
+        return;
+    }
+
+    present = ESClient_hasAttachments(cb->priv->conn, sha1s, &local_err);
+    g_slist_free(sha1s);
+
+    if (local_err)
+    {
+        g_print("ATTACH: hasAttachments failed (%s), uploading all\n", local_err->message);
+        g_clear_error(&local_err);
+        return;
+    }
+
+    for (iter = attachments; iter; iter = iter->next)
+    {
+        attachment *a = iter->data;
+
+        if (a->sha1 && g_slist_find_custom(present, a->sha1, (GCompareFunc)g_ascii_strcasecmp))
+        {
+            a->is_on_server = TRUE;
+            changed = TRUE;
+        }
+    }
+
+    if (changed)
+    {
+        e_cal_backend_3e_attachment_store_save(cb);
+    }
+
+    Array_string_free(present);
+}
+
 static gboolean download_attachment(ECalBackend3e *cb, attachment *att, GError * *err)
 {
     GError *local_err = NULL;
@@ -273,6 +395,7 @@ static gboolean download_attachment(ECalBackend3e *cb, attachment *att, GError *
     GFile *file = g_file_new_for_uri(att->local_uri);
     if (g_file_query_exists(file, NULL))
     {
+        att->is_in_cache = TRUE;
         g_object_unref(file);
         return TRUE;
     }
@@ -315,7 +438,8 @@ static gboolean download_attachment(ECalBackend3e *cb, attachment *att, GError *
             g_file_move(tmp_file, file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, NULL);
             att->is_on_server = TRUE;
             att->is_in_cache = TRUE;
-            e_cal_backend_3e_attachment_store_save(cb);
+            att->size = -1;
+            attachment_touch(att);
             retval = TRUE;
         }
     }
@@ -358,6 +482,65 @@ static char *convert_attachment_to_local(ECalBackend3e *cb, ECalComponent *comp,
     return a ? g_strdup(a->local_uri) : NULL;
 }
 
+/* Download attachment from the server without holding attachments_mutex
+ * during the transfer. The download goes to a private copy of the store entry,
+ * the entry itself is looked up again and updated afterwards. Only attachments
+ * already in the store are downloaded and only one download of each runs at a
+ * time. If only_evicted is TRUE, attachments with a local copy or not yet
+ * uploaded to the server are skipped. */
+static gboolean fetch_attachment(ECalBackend3e *cb, const char *uri, gboolean only_evicted, GError * *err)
+{
+    attachment *a;
+    attachment *copy;
+    gboolean retval;
+
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
+    a = find_attachment(cb, uri);
+    if (a == NULL)
+    {
+        g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+        return TRUE;
+    }
+
+    attachment_touch(a);
+
+    if (a->is_downloading || (only_evicted && (a->is_in_cache || !a->is_on_server || cb->priv->server_uri == NULL)))
+    {
+        g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+        return TRUE;
+    }
+
+    copy = attachment_copy(a);
+    a->is_downloading = TRUE;
+
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+
+    retval = download_attachment(cb, copy, err);
+
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
+    a = find_attachment(cb, uri);
+    if (a)
+    {
+        a->is_downloading = FALSE;
+        if (retval)
+        {
+            a->is_on_server = copy->is_on_server;
+            a->is_in_cache = TRUE;
+            a->size = -1;
+            attachment_touch(a);
+            e_cal_backend_3e_attachment_store_save(cb);
+        }
+    }
+
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+
+    attachment_free(copy);
+
+    return retval;
+}
+
 static char *convert_attachment_to_remote(ECalBackend3e *cb, ECalComponent *comp, const char *uri)
 {
     attachment *a = get_attacmhent(cb, comp, uri);
@@ -387,6 +570,8 @@ gboolean e_cal_backend_3e_attachment_store_save(ECalBackend3e *cb)
 
     xmlDocSetRootElement(doc, root);
 
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
     for (iter = cb->priv->attachments; iter; iter = iter->next)
     {
         attachment *a = iter->data;
@@ -398,8 +583,21 @@ gboolean e_cal_backend_3e_attachment_store_save(ECalBackend3e *cb)
         xmlSetProp(att, BAD_CAST "filename", BAD_CAST a->filename);
         xmlSetProp(att, BAD_CAST "is_on_server", BAD_CAST(a->is_on_server ? "1" : "0"));
         xmlSetProp(att, BAD_CAST "is_in_cache", BAD_CAST(a->is_in_cache ? "1" : "0"));
+
+        char *last_access = g_strdup_printf("%ld", (long)a->last_access);
+        xmlSetProp(att, BAD_CAST "last_access", BAD_CAST last_access);
+        g_free(last_access);
+
+        if (a->size >= 0)
+        {
+            char *size = g_strdup_printf("%" G_GINT64_FORMAT, (gint64)a->size);
+            xmlSetProp(att, BAD_CAST "size", BAD_CAST size);
+            g_free(size);
+        }
     }
 
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+
     char *path = get_attachments_store_file(cb);
     int rs = xmlSaveFormatFile(path, doc, 1);
     g_free(path);
@@ -421,6 +619,8 @@ void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb)
     g_free(path);
     xmlNode *root = xmlDocGetRootElement(doc);
 
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
     e_cal_backend_3e_attachment_store_free(cb);
 
     if (root)
@@ -440,6 +640,8 @@ void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb)
             xmlChar *filename = xmlGetProp(item, BAD_CAST "filename");
             xmlChar *is_on_server = xmlGetProp(item, BAD_CAST "is_on_server");
             xmlChar *is_in_cache = xmlGetProp(item, BAD_CAST "is_in_cache");
+            xmlChar *last_access = xmlGetProp(item, BAD_CAST "last_access");
+            xmlChar *size = xmlGetProp(item, BAD_CAST "size");
 
             attachment *a = g_new0(attachment, 1);
             a->eee_uri = g_strdup((char *)eee_uri);
@@ -448,6 +650,8 @@ void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb)
             a->filename = g_strdup((char *)filename);
             a->is_on_server = is_on_server ? is_on_server[0] == '1' : FALSE;
             a->is_in_cache = is_in_cache ? is_in_cache[0] == '1' : FALSE;
+            a->last_access = last_access ? (time_t)g_ascii_strtoll((char *)last_access, NULL, 10) : 0;
+            a->size = size ? (goffset)g_ascii_strtoll((char *)size, NULL, 10) : -1;
 
             xmlFree(eee_uri);
             xmlFree(local_uri);
@@ -455,11 +659,15 @@ void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb)
             xmlFree(filename);
             xmlFree(is_on_server);
             xmlFree(is_in_cache);
+            xmlFree(last_access);
+            xmlFree(size);
 
             cb->priv->attachments = g_slist_append(cb->priv->attachments, a);
         }
     }
 
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+
     xmlFreeDoc(doc);
 }
 
@@ -469,9 +677,11 @@ void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb)
  */
 void e_cal_backend_3e_attachment_store_free(ECalBackend3e *cb)
 {
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
     g_slist_foreach(cb->priv->attachments, (GFunc)attachment_free, NULL);
     g_slist_free(cb->priv->attachments);
     cb->priv->attachments = NULL;
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
 }
 
 /** Convert attachment URIs from the eee:// format to the file:// format.
@@ -605,6 +815,120 @@ gboolean e_cal_backend_3e_convert_attachment_uris_to_remote_icalcomp(ECalBackend
     return retval;
 }
 
+/* Evict least recently used attachments from the local cache.
+ *
+ * Local copies are removed, oldest last access first, until the cache fits
+ * into the budget set by the eee-attachment-cache-size ESource property (in
+ * MiB, 0 means unlimited). Attachments not yet uploaded to the server and
+ * attachments in the keep list (the ones the caller has just used) are never
+ * evicted. Evicted attachments stay in the store and are downloaded again on
+ * demand. */
+static void attachment_store_evict(ECalBackend3e *cb, GSList *keep)
+{
+    GSList *iter;
+    goffset total = 0;
+    goffset limit;
+    gboolean changed = FALSE;
+
+    if (cb->priv->attachment_cache_size == 0)
+    {
+        return;
+    }
+
+    limit = (goffset)cb->priv->attachment_cache_size * 1024 * 1024;
+
+    g_static_rec_mutex_lock(&cb->priv->attachments_mutex);
+
+    for (iter = cb->priv->attachments; iter; iter = iter->next)
+    {
+        attachment *a = iter->data;
+
+        if (a->is_in_cache)
+        {
+            total += attachment_get_size(a);
+        }
+    }
+
+    while (total > limit)
+    {
+        attachment *victim = NULL;
+
+        for (iter = cb->priv->attachments; iter; iter = iter->next)
+        {
+            attachment *a = iter->data;
+
+            if (a->is_in_cache && a->is_on_server && !g_slist_find(keep, a) &&
+                (victim == NULL || a->last_access < victim->last_access))
+            {
+                victim = a;
+            }
+        }
+
+        if (victim == NULL)
+        {
+            break;
+        }
+
+        g_print("ATTACH: evict(%s)\n", victim->local_uri);
+
+        char *path = g_filename_from_uri(victim->local_uri, NULL, NULL);
+        if (path)
+        {
+            g_unlink(path);
+            g_free(path);
+        }
+
+        total -= attachment_get_size(victim);
+        victim->is_in_cache = FALSE;
+        victim->size = -1;
+        changed = TRUE;
+    }
+
+    if (changed)
+    {
+        e_cal_backend_3e_attachment_store_save(cb);
+    }
+
+    g_static_rec_mutex_unlock(&cb->priv->attachments_mutex);
+}
+
+/** Download attachments evicted from the local cache again.
+ *
+ * Called when a single component is opened by the client, never for list or
+ * view queries. URIs not present in the attachment store are left alone. The
+ * store is not locked during the download and nothing is evicted here, refetched
+ * attachments are the most recently used ones and eviction is left to the sync
+ * thread.
+ *
+ * @param cb 3E calendar backend.
+ * @param comp ECalComponent object.
+ */
+void e_cal_backend_3e_refetch_evicted_attachments(ECalBackend3e *cb, ECalComponent *comp)
+{
+    GError *local_err = NULL;
+    GSList *attachments = NULL;
+    GSList *iter;
+
+    g_return_if_fail(comp != NULL);
+
+    if (!e_cal_component_has_attachments(comp))
+    {
+        return;
+    }
+
+    e_cal_component_get_attachment_list(comp, &attachments);
+    for (iter = attachments; iter; iter = iter->next)
+    {
+        if (g_str_has_prefix(iter->data, "file://") && !fetch_attachment(cb, iter->data, TRUE, &local_err))
+        {
+            g_print("ATTACH: refetch failed (%s)\n", local_err ? local_err->message : "Unknown error");
+            g_clear_error(&local_err);
+        }
+    }
+
+    g_slist_free(attachments);
+}
+
 /** Upload all attachments to the 3E server.
  *
  * This method must cancel uploads and return FALSE if sync thread shutdown is requested.
@@ -619,6 +943,7 @@ gboolean e_cal_backend_3e_upload_attachments(ECalBackend3e *cb, ECalComponent *c
 {
     GError *local_err = NULL;
     GSList *attachments = NULL;
+    GSList *pending = NULL;
     GSList *iter;
     gboolean rs = TRUE;
 
@@ -631,15 +956,31 @@ gboolean e_cal_backend_3e_upload_attachments(ECalBackend3e *cb, ECalComponent *c
         attachment *a = get_attacmhent(cb, comp, iter->data);
         if (a)
         {
-            if (!upload_attachment(cb, a, &local_err))
-            {
-                e_cal_backend_notify_gerror_error(E_CAL_BACKEND(cb), "Can't upload attachment.", local_err);
-                g_clear_error(&local_err);
-                rs = FALSE;
-            }
+            pending = g_slist_append(pending, a);
         }
     }
 
+    query_attachments_on_server(cb, pending);
+
+    for (iter = pending; iter; iter = iter->next)
+    {
+        attachment *a = iter->data;
+
+        if (a->is_on_server)
+        {
+            g_print("ATTACH: skip upload(%s), already on server\n", a->eee_uri);
+            continue;
+        }
+
+        if (!upload_attachment(cb, a, &local_err))
+        {
+            e_cal_backend_notify_gerror_error(E_CAL_BACKEND(cb), "Can't upload attachment.", local_err);
+            g_clear_error(&local_err);
+            rs = FALSE;
+        }
+    }
+
+    g_slist_free(pending);
     g_slist_free(attachments);
 
     return rs;
@@ -659,6 +1000,7 @@ gboolean e_cal_backend_3e_download_attachments(ECalBackend3e *cb, ECalComponent
 {
     GError *local_err = NULL;
     GSList *attachments = NULL;
+    GSList *used = NULL;
     GSList *iter;
     gboolean rs = TRUE;
 
@@ -671,7 +1013,8 @@ gboolean e_cal_backend_3e_download_attachments(ECalBackend3e *cb, ECalComponent
         attachment *a = get_attacmhent(cb, comp, iter->data);
         if (a)
         {
-            if (!download_attachment(cb, a, &local_err))
+            used = g_slist_append(used, a);
+            if (!fetch_attachment(cb, a->local_uri, FALSE, &local_err))
             {
                 e_cal_backend_notify_gerror_error(E_CAL_BACKEND(cb), "Can't download attachment.", local_err);
                 g_clear_error(&local_err);
@@ -680,6 +1023,9 @@ gboolean e_cal_backend_3e_download_attachments(ECalBackend3e *cb, ECalComponent
         }
     }
 
+    attachment_store_evict(cb, used);
+
+    g_slist_free(used);
     g_slist_free(attachments);
 
     return rs;
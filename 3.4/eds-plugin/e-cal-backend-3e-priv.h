@@ -28,6 +28,10 @@
 #include "e-cal-backend-3e.h"
 #include "interface/ESClient.xrc.h"
 
+/** Default local attachment cache budget in MiB, used when the ESource does
+ * not set the eee-attachment-cache-size property. */
+#define ATTACHMENT_CACHE_DEFAULT_SIZE 256
+
 #define E_CAL_BACKEND_3E_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_CAL_BACKEND_3E, ECalBackend3ePrivate))
@@ -71,7 +75,9 @@ struct _ECalBackend3ePrivate
     gboolean sync_immediately;      /**< If TRUE, e_cal_backend_3e_sync_cache_to_server() is run after cache mod operations. */
     GQueue *message_queue;          /**< iTIP messages queue. */
     GMutex *message_queue_mutex;    /**< Protects messages queue. */
-    GSList *attachments;
+    GSList *attachments;            /**< Attachment store (list of known attachments). */
+    GStaticRecMutex attachments_mutex; /**< Protects attachment store. */
+    guint attachment_cache_size;    /**< Local attachment cache budget in MiB (0 = unlimited). */
     /** @} */
 
     /** @addtogroup eds_sync */
@@ -155,6 +161,7 @@ gboolean e_cal_backend_3e_convert_attachment_uris_to_remote(ECalBackend3e *cb, E
 gboolean e_cal_backend_3e_convert_attachment_uris_to_remote_icalcomp(ECalBackend3e *cb, icalcomponent *comp);
 gboolean e_cal_backend_3e_upload_attachments(ECalBackend3e *cb, ECalComponent *comp, GError * *err);
 gboolean e_cal_backend_3e_download_attachments(ECalBackend3e *cb, ECalComponent *comp, GError * *err);
+void e_cal_backend_3e_refetch_evicted_attachments(ECalBackend3e *cb, ECalComponent *comp);
 void e_cal_backend_3e_attachment_store_free(ECalBackend3e *cb);
 void e_cal_backend_3e_attachment_store_load(ECalBackend3e *cb);
 gboolean e_cal_backend_3e_attachment_store_save(ECalBackend3e *cb);
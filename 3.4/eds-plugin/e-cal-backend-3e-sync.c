@@ -217,9 +217,11 @@ gboolean e_cal_backend_3e_calendar_info_load(ECalBackend3e *cb)
 {
     ESource *source;
     const char *immediate_sync;
+    const char *attachment_cache_size;
 
     source = e_backend_get_source(E_BACKEND(cb));
     immediate_sync = e_source_get_property(source, "eee-immediate-sync");
+    attachment_cache_size = e_source_get_property(source, "eee-attachment-cache-size");
 
     g_free(cb->priv->calname);
     g_free(cb->priv->owner);
@@ -228,6 +230,7 @@ gboolean e_cal_backend_3e_calendar_info_load(ECalBackend3e *cb)
     cb->priv->owner = g_strdup(e_source_get_property(source, "eee-owner"));
     cb->priv->perm = g_strdup(e_source_get_property(source, "eee-perm"));
     cb->priv->sync_immediately = (immediate_sync == NULL || !g_strcmp0(immediate_sync, "1"));
+    cb->priv->attachment_cache_size = attachment_cache_size ? strtoul(attachment_cache_size, NULL, 10) : ATTACHMENT_CACHE_DEFAULT_SIZE;
 
     g_free(cb->priv->calspec);
     cb->priv->calspec = g_strdup_printf("%s:%s", cb->priv->owner, cb->priv->calname);
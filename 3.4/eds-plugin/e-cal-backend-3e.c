@@ -308,6 +308,9 @@ static void e_cal_backend_3e_get_object(ECalBackendSync *backend,
             return;
         }
 
+        /* bring back attachments evicted from the local cache */
+        e_cal_backend_3e_refetch_evicted_attachments(cb, dinst);
+
         //*object = e_cal_component_get_as_string(dinst);
         *object = g_strdup(icalcomponent_as_ical_string(e_cal_component_get_icalcomponent(dinst)));
         g_object_unref(dinst);
@@ -325,6 +328,7 @@ static void e_cal_backend_3e_get_object(ECalBackendSync *backend,
         if (!e_cal_component_has_recurrences(master))
         {
             /* normal non-recurring object */
+            e_cal_backend_3e_refetch_evicted_attachments(cb, master);
             //*object = e_cal_component_get_as_string(master);
             *object = g_strdup(icalcomponent_as_ical_string(e_cal_component_get_icalcomponent(master)));
         }
@@ -339,6 +343,7 @@ static void e_cal_backend_3e_get_object(ECalBackendSync *backend,
             for (iter = dinst_list; iter; iter = iter->next)
             {
 	        ECalComponent *dinst = E_CAL_COMPONENT(iter->data);
+	        e_cal_backend_3e_refetch_evicted_attachments(cb, dinst);
 	        icalcomponent_add_component(icalcomp, icalcomponent_new_clone(e_cal_component_get_icalcomponent(dinst)));
                 g_object_unref(dinst);
             }
@@ -1066,6 +1071,7 @@ static void e_cal_backend_3e_init(ECalBackend3e *cb)
 
     g_static_rw_lock_init(&cb->priv->cache_lock);
     g_static_rec_mutex_init(&cb->priv->conn_mutex);
+    g_static_rec_mutex_init(&cb->priv->attachments_mutex);
     cb->priv->sync_mutex = g_mutex_new();
 
     e_cal_backend_sync_set_lock(E_CAL_BACKEND_SYNC(cb), TRUE);
@@ -1081,6 +1087,7 @@ static void e_cal_backend_3e_finalize(GObject *backend)
 
     g_static_rw_lock_free(&priv->cache_lock);
     g_static_rec_mutex_free(&priv->conn_mutex);
+    g_static_rec_mutex_free(&priv->attachments_mutex);
     g_mutex_free(priv->sync_mutex);
 
     /* calinfo */
@@ -53,6 +53,9 @@ enum
     USERS_NUM_COLUMNS
 };
 
+/* Delay after last keystroke before users are looked up (ms). */
+#define USERS_LOOKUP_DELAY 300
+
 struct acl_perm
 {
     ESUserPermission perm;
@@ -137,15 +140,68 @@ static void on_acl_button_cancel_clicked(GtkButton *button, struct acl_context *
     gtk_widget_destroy(GTK_WIDGET(ctx->win));
 }
 
-// store ACL to the 3e server
+struct acl_store
+{
+    char *calname;
+    int initial_mode;
+    int new_mode;
+    GSList *perms;
+};
+
+static void acl_store_free(struct acl_store *store)
+{
+    g_slist_foreach(store->perms, (GFunc)ESUserPermission_free, NULL);
+    g_slist_free(store->perms);
+    g_free(store->calname);
+    g_free(store);
+}
+
+// store ACL to the 3e server, runs in account's async thread
+static void acl_store_func(EeeAccount *account, struct acl_store *store, GCancellable *cancellable)
+{
+    if (store->initial_mode == store->new_mode)
+    {
+        if (store->new_mode == ACL_MODE_SHARED)
+        {
+            eee_account_calendar_acl_set_shared(account, store->calname, store->perms);
+        }
+    }
+    else
+    {
+        if (store->new_mode == ACL_MODE_PRIVATE)
+        {
+            eee_account_calendar_acl_set_private(account, store->calname);
+        }
+        else if (store->new_mode == ACL_MODE_PUBLIC)
+        {
+            eee_account_calendar_acl_set_public(account, store->calname);
+        }
+        else if (store->new_mode == ACL_MODE_SHARED)
+        {
+            eee_account_calendar_acl_set_shared(account, store->calname, store->perms);
+        }
+    }
+}
+
+// store ACL to the 3e server in background, so that dialog can be closed
+// right away
 gboolean store_acl(struct acl_context *ctx)
 {
     GtkTreeIter iter;
-    int new_mode = get_acl_mode(ctx);
-    GSList *perms = NULL;
-    gboolean retval;
+    struct acl_store *store;
+
+    // never overwrite ACL we don't know
+    if (ctx == NULL || !ctx->loaded)
+    {
+        return FALSE;
+    }
+
+    store = g_new0(struct acl_store, 1);
+    store->calname = g_strdup(e_source_get_property(ctx->source, "eee-calname"));
+    store->initial_mode = ctx->initial_mode;
+    store->new_mode = get_acl_mode(ctx);
 
-    if (new_mode == ACL_MODE_SHARED)
+    if (store->new_mode == ACL_MODE_SHARED)
     {
         // build list of users and permissions
         if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(ctx->acl_model), &iter))
@@ -157,42 +213,17 @@ gboolean store_acl(struct acl_context *ctx)
                                    ACL_USERNAME_COLUMN, &p->user,
                                    ACL_PERM_COLUMN, &p->perm,
                                    -1);
-                perms = g_slist_append(perms, p);
+                store->perms = g_slist_prepend(store->perms, p);
             }
             while (gtk_tree_model_iter_next(GTK_TREE_MODEL(ctx->acl_model), &iter));
         }
+        store->perms = g_slist_reverse(store->perms);
     }
 
-    const char *calname = e_source_get_property(ctx->source, "eee-calname");
-    if (ctx->initial_mode == new_mode)
-    {
-        if (new_mode == ACL_MODE_SHARED)
-        {
-            retval = eee_account_calendar_acl_set_shared(ctx->account, calname, perms);
-        }
-    }
-    else
-    {
-        if (new_mode == ACL_MODE_PRIVATE)
-        {
-            retval = eee_account_calendar_acl_set_private(ctx->account, calname);
-        }
-        else if (new_mode == ACL_MODE_PUBLIC)
-        {
-            retval = eee_account_calendar_acl_set_public(ctx->account, calname);
-        }
-        else if (new_mode == ACL_MODE_SHARED)
-        {
-            retval = eee_account_calendar_acl_set_shared(ctx->account, calname, perms);
-        }
-    }
+    eee_account_run_async(ctx->account, (EeeAccountAsyncFunc)acl_store_func, NULL,
+                          store, (GDestroyNotify)acl_store_free, NULL);
 
-    g_slist_foreach(perms, (GFunc)ESUserPermission_free, NULL);
-    g_slist_free(perms);
-
-    eee_account_disconnect(ctx->account);
-
-    return retval;
+    return TRUE;
 }
 
 static void on_acl_button_ok_clicked(GtkButton *button, struct acl_context *ctx)
@@ -205,8 +236,24 @@ static void on_acl_button_ok_clicked(GtkButton *button, struct acl_context *ctx)
 
 void acl_perm_free(struct acl_perm *p)
 {
+    g_free(p->perm.user);
+    g_free(p->perm.perm);
     g_free(p->realname);
-    ESUserPermission_free((ESUserPermission *)p);
+    g_free(p);
+}
+
+static void acl_perms_free(GArray *perms)
+{
+    guint i;
+
+    if (perms == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < perms->len; i++)
+        acl_perm_free (g_array_index (perms, struct acl_perm *, i));
+    g_array_free (perms, TRUE);
 }
 
 #if EDS_CHECK_VERSION(3,0,0)
@@ -215,63 +262,107 @@ static void on_acl_window_destroy(GtkWidget *object, struct acl_context *ctx)
 static void on_acl_window_destroy(GtkObject *object, struct acl_context *ctx)
 #endif /* !EDS_CHECK_VERSION(3,0,0) */
 {
+    // drop result of loading that is still running
+    g_cancellable_cancel(ctx->cancellable);
+    g_object_unref(ctx->cancellable);
+    if (ctx->users_cancellable)
+    {
+        g_cancellable_cancel(ctx->users_cancellable);
+        g_object_unref(ctx->users_cancellable);
+    }
+    if (ctx->users_lookup_source)
+        g_source_remove(ctx->users_lookup_source);
+    g_hash_table_destroy(ctx->users_cache);
+    g_free(ctx->users_pending);
+
     g_object_unref(ctx->win);
     g_object_unref(ctx->source);
     g_object_unref(ctx->account);
     g_object_unref(ctx->builder);
 
-    guint i;
-    for (i = 0; i < ctx->initial_perms->len; i++)
-        acl_perm_free (g_array_index (ctx->initial_perms, struct acl_perm *, i));
-    g_array_free (ctx->initial_perms, TRUE);
+    acl_perms_free(ctx->initial_perms);
 
     acl_contexts = g_slist_remove(acl_contexts, ctx);
     g_free(ctx);
 }
 
-static gboolean load_state(struct acl_context *ctx)
+struct acl_load
+{
+    struct acl_context *ctx;
+    char *calname;
+    gboolean ok;
+    GArray *perms;      // struct acl_perm
+};
+
+static void acl_load_free(struct acl_load *load)
+{
+    acl_perms_free(load->perms);
+    g_free(load->calname);
+    g_free(load);
+}
+
+// load ACL from the 3e server, runs in account's async thread
+static void acl_load_func(EeeAccount *account, struct acl_load *load, GCancellable *cancellable)
 {
     GError *err = NULL;
+    GSList *usernames = NULL;
+    GArray *perms;
     guint i;
 
-    char *calname = (char *)e_source_get_property(ctx->source, "eee-calname");
-    xr_client_conn *conn = eee_account_connect(ctx->account);
+    xr_client_conn *conn = eee_account_connect(account);
 
-    if (!eee_account_auth(ctx->account))
+    if (!eee_account_auth(account))
     {
-        return FALSE;
+        return;
     }
 
-    GArray *perms = ESClient_getUserPermissions(conn, calname, &err);
+    perms = ESClient_getUserPermissions(conn, load->calname, &err);
     if (err)
     {
         g_warning("** EEE ** Can't get permissions. (%d:%s)", err->code, err->message);
         g_clear_error(&err);
-        eee_account_disconnect(ctx->account);
-        return FALSE;
+        eee_account_disconnect(account);
+        return;
+    }
+
+    for (i = 0; i < perms->len; i++)
+    {
+        ESUserPermission *perm = g_array_index (perms, ESUserPermission *, i);
+        usernames = g_slist_prepend(usernames, perm->user);
     }
+    eee_account_prefetch_realnames(account, usernames);
+    g_slist_free(usernames);
 
+    load->perms = g_array_sized_new(FALSE, TRUE, sizeof(struct acl_perm *), perms->len);
     for (i = 0; i < perms->len; i++)
     {
-        GArray *attrs = NULL;
-        struct acl_perm *perm = g_renew(struct acl_perm, g_array_index (perms, struct acl_perm *, i), 1);
-        eee_account_get_user_attributes(ctx->account, perm->perm.user, &attrs);
-        perm->realname = g_strdup(eee_find_attribute_value(attrs, "realname"));
-        eee_account_free_attributes_list(attrs);
+        ESUserPermission *perm = g_array_index (perms, ESUserPermission *, i);
+        struct acl_perm *p = g_new0(struct acl_perm, 1);
+
+        // steal strings from the server response
+        p->perm.user = perm->user;
+        p->perm.perm = perm->perm;
+        perm->user = NULL;
+        perm->perm = NULL;
+        p->realname = g_strdup(eee_account_peek_realname(account, p->perm.user));
+        g_array_append_val(load->perms, p);
     }
+    Array_ESUserPermission_free (perms);
 
-    eee_account_disconnect(ctx->account);
+    load->ok = TRUE;
+}
 
-    // parse permissions
-    // - no permissions (empty list) => private
-    // - '*' => public
-    // - some permissions => shared
+// parse permissions
+// - no permissions (empty list) => private
+// - '*' => public
+// - some permissions => shared
+static int acl_mode_from_perms(GArray *perms)
+{
+    guint i;
 
-    ctx->initial_perms = perms;
     if (perms == NULL || perms->len == 0)
     {
-        ctx->initial_mode = ACL_MODE_PRIVATE;
-        return TRUE;
+        return ACL_MODE_PRIVATE;
     }
 
     for (i = 0; i < perms->len; i++)
@@ -279,13 +370,47 @@ static gboolean load_state(struct acl_context *ctx)
         ESUserPermission *perm = g_array_index (perms, ESUserPermission *, i);
         if (!strcmp(perm->user, "*"))
         {
-            ctx->initial_mode = ACL_MODE_PUBLIC;
-            return TRUE;
+            return ACL_MODE_PUBLIC;
         }
     }
 
-    ctx->initial_mode = ACL_MODE_SHARED;
-    return TRUE;
+    return ACL_MODE_SHARED;
+}
+
+void update_gui_state(struct acl_context *ctx);
+
+// ACL is loaded, show it and let user edit it
+static void acl_load_done(EeeAccount *account, struct acl_load *load)
+{
+    struct acl_context *ctx = load->ctx;
+
+    if (!load->ok)
+    {
+        GtkWidget *toplevel = gtk_widget_get_toplevel(ctx->win);
+        GtkWidget *dialog;
+
+        g_warning("** EEE ** Can't load ACL of calendar '%s'.", load->calname);
+
+        // ACL stays unknown (ctx->loaded is FALSE), so store_acl() won't
+        // overwrite it, just tell user and don't leave the dialog blocked
+        dialog = gtk_message_dialog_new(GTK_IS_WINDOW(toplevel) ? GTK_WINDOW(toplevel) : NULL,
+                                        GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+                                        "%s", _("Can't load sharing settings of the calendar from the 3e server. Changes of sharing settings will not be saved."));
+        g_signal_connect_swapped(dialog, "response", G_CALLBACK(gtk_widget_destroy), dialog);
+        gtk_widget_show(dialog);
+        gtk_widget_set_sensitive(ctx->win, TRUE);
+        return;
+    }
+
+    acl_perms_free(ctx->initial_perms);
+    ctx->initial_perms = load->perms;
+    load->perms = NULL;
+    ctx->initial_mode = acl_mode_from_perms(ctx->initial_perms);
+
+    update_gui_state(ctx);
+
+    ctx->loaded = TRUE;
+    gtk_widget_set_sensitive(ctx->win, TRUE);
 }
 
 void update_gui_state(struct acl_context *ctx)
@@ -326,21 +451,187 @@ static void editing_started(GtkCellRenderer *renderer, GtkCellEditable *editable
     }
 }
 
-static void update_users_list(struct acl_context *ctx)
+// show users matching prefix (casefolded) in the completion model, users that
+// already are in the ACL are left out
+static void update_users_list(struct acl_context *ctx, GArray *users, const char *prefix)
 {
-    // get a list of users to ignore
-    GSList *users = NULL;
+    GHashTable *exclude = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GtkTreeIter titer_user;
     guint i;
 
-    for (i = 0; i < ctx->initial_perms->len; i++)
+    if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(ctx->acl_model), &titer_user))
     {
-        ESUserPermission *perm = g_array_index (ctx->initial_perms, ESUserPermission *, i);
-        users = g_slist_append(users, perm->user);
+        do
+        {
+            char *username = NULL;
+            gtk_tree_model_get(GTK_TREE_MODEL(ctx->acl_model), &titer_user, ACL_USERNAME_COLUMN, &username, -1);
+            if (username)
+                g_hash_table_insert(exclude, username, GINT_TO_POINTER(TRUE));
+        }
+        while (gtk_tree_model_iter_next(GTK_TREE_MODEL(ctx->acl_model), &titer_user));
     }
+
     gtk_list_store_clear(ctx->users_model);
-    eee_account_load_users(ctx->account, NULL, users, ctx->users_model);
-    g_slist_free(users);
-    eee_account_disconnect(ctx->account);
+    for (i = 0; users && i < users->len; i++)
+    {
+        ESUserInfo *user = g_array_index (users, ESUserInfo *, i);
+        const char *realname;
+        char *username;
+        gboolean matches;
+
+        // server matches usernames case-insensitively
+        username = g_utf8_casefold(user->username, -1);
+        matches = g_str_has_prefix(username, prefix);
+        g_free(username);
+
+        if (!matches || !g_strcmp0(ctx->account->name, user->username) ||
+            g_hash_table_lookup(exclude, user->username))
+            continue;
+
+        realname = eee_find_attribute_value(user->attrs, "realname");
+        gtk_list_store_append(ctx->users_model, &titer_user);
+        gtk_list_store_set(ctx->users_model, &titer_user,
+                           USERS_USERNAME_COLUMN, user->username,
+                           USERS_REALNAME_COLUMN, realname ? realname : "???",
+                           USERS_ACCOUNT_COLUMN, ctx->account,
+                           -1);
+    }
+
+    g_hash_table_destroy(exclude);
+}
+
+// find cached result for the longest cached prefix of text (casefolded),
+// server returns all users matching prefix, so it contains all users matching
+// text too
+static GArray *users_cache_lookup(struct acl_context *ctx, const char *text)
+{
+    char *prefix = g_strdup(text);
+    size_t len = strlen(prefix);
+    GArray *users = NULL;
+
+    while (TRUE)
+    {
+        prefix[len] = '\0';
+        users = g_hash_table_lookup(ctx->users_cache, prefix);
+        if (users || len == 0)
+            break;
+        len = g_utf8_prev_char(prefix + len) - prefix;
+    }
+
+    g_free(prefix);
+    return users;
+}
+
+struct users_lookup
+{
+    struct acl_context *ctx;
+    char *prefix;
+    gboolean ok;
+    GArray *users;      // ESUserInfo
+};
+
+static void users_lookup_free(struct users_lookup *lookup)
+{
+    if (lookup->users)
+        Array_ESUserInfo_free (lookup->users);
+    g_free(lookup->prefix);
+    g_free(lookup);
+}
+
+// get users matching prefix from the 3e server, runs in account's async thread
+static void users_lookup_func(EeeAccount *account, struct users_lookup *lookup, GCancellable *cancellable)
+{
+    lookup->ok = eee_account_get_users(account, lookup->prefix, &lookup->users);
+}
+
+static void refresh_users_list(struct acl_context *ctx);
+
+static void users_lookup_done(EeeAccount *account, struct users_lookup *lookup)
+{
+    struct acl_context *ctx = lookup->ctx;
+
+    if (!g_strcmp0(ctx->users_pending, lookup->prefix))
+    {
+        g_free(ctx->users_pending);
+        ctx->users_pending = NULL;
+        g_object_unref(ctx->users_cancellable);
+        ctx->users_cancellable = NULL;
+    }
+
+    if (!lookup->ok)
+    {
+        return;
+    }
+
+    g_hash_table_insert(ctx->users_cache, lookup->prefix, lookup->users);
+    lookup->prefix = NULL;
+    lookup->users = NULL;
+
+    // user may have typed more meanwhile
+    refresh_users_list(ctx);
+}
+
+// show users matching text in the entry, fetch them from the server only if
+// no result for any prefix of the text is cached or on the way, the text is
+// casefolded, because the server matches usernames case-insensitively
+static void refresh_users_list(struct acl_context *ctx)
+{
+    const char *entry_text = gtk_entry_get_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(ctx->user_entry))));
+    char *text;
+    GArray *users;
+    struct users_lookup *lookup;
+
+    if (entry_text[0] == '\0')
+    {
+        return;
+    }
+
+    text = g_utf8_casefold(entry_text, -1);
+
+    users = users_cache_lookup(ctx, text);
+    if (users)
+    {
+        update_users_list(ctx, users, text);
+        g_free(text);
+        return;
+    }
+
+    if (ctx->users_pending)
+    {
+        // pending result will be narrowed down locally when it arrives
+        if (g_str_has_prefix(text, ctx->users_pending))
+        {
+            g_free(text);
+            return;
+        }
+        // that's not worth waiting for, new request will replace it
+        g_cancellable_cancel(ctx->users_cancellable);
+        g_object_unref(ctx->users_cancellable);
+        g_free(ctx->users_pending);
+    }
+
+    ctx->users_pending = text;
+    ctx->users_cancellable = g_cancellable_new();
+    lookup = g_new0(struct users_lookup, 1);
+    lookup->ctx = ctx;
+    lookup->prefix = g_strdup(text);
+    eee_account_run_async(ctx->account, (EeeAccountAsyncFunc)users_lookup_func, (EeeAccountAsyncDone)users_lookup_done,
+                          lookup, (GDestroyNotify)users_lookup_free, ctx->users_cancellable);
+}
+
+static gboolean users_lookup_cb(struct acl_context *ctx)
+{
+    ctx->users_lookup_source = 0;
+    refresh_users_list(ctx);
+    return FALSE;
+}
+
+// user typed into the entry, wait for a pause in typing before looking users up
+static void user_entry_changed(GtkEditable *editable, struct acl_context *ctx)
+{
+    if (ctx->users_lookup_source)
+        g_source_remove(ctx->users_lookup_source);
+    ctx->users_lookup_source = g_timeout_add(USERS_LOOKUP_DELAY, (GSourceFunc)users_lookup_cb, ctx);
 }
 
 // acl permission for given user in the treeview was changed, update acl
@@ -527,6 +818,7 @@ static void combo_add_completion(GtkComboBox *cbe, struct acl_context *ctx)
     g_signal_connect_after(completion, "match-selected", G_CALLBACK(user_selected), ctx);
     g_signal_connect(cbe, "changed", G_CALLBACK(cbe_changed), ctx);
     g_signal_connect(entry, "key-press-event", G_CALLBACK(combo_entry_keypress), ctx);
+    g_signal_connect(entry, "changed", G_CALLBACK(user_entry_changed), ctx);
     g_object_unref(completion);
 }
 
@@ -615,14 +907,18 @@ acl_gui_create(EeeAccountsManager *mgr, EeeAccount *account, ESource *source)
 
     gtk_builder_connect_signals_full (c->builder, connect_signals, c);
 
-    if (!load_state(c))
-    {
-        gtk_widget_destroy(c->win);
-        return NULL;
-    }
+    // show dialog right away, it becomes editable once ACL is loaded
+    c->initial_perms = g_array_new(FALSE, TRUE, sizeof(struct acl_perm *));
+    c->cancellable = g_cancellable_new();
+    c->users_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)Array_ESUserInfo_free);
+    gtk_widget_set_sensitive(c->win, FALSE);
+
+    struct acl_load *load = g_new0(struct acl_load, 1);
+    load->ctx = c;
+    load->calname = g_strdup(e_source_get_property(source, "eee-calname"));
+    eee_account_run_async(account, (EeeAccountAsyncFunc)acl_load_func, (EeeAccountAsyncDone)acl_load_done,
+                          load, (GDestroyNotify)acl_load_free, c->cancellable);
 
-    update_users_list(c);
-    update_gui_state(c);
     acl_contexts = g_slist_append(acl_contexts, c);
     gtk_widget_show(c->win);
     return c;
@@ -44,6 +44,14 @@ struct acl_context
     // initial state
     int initial_mode;
     GArray *initial_perms;
+    gboolean loaded;            // initial state was loaded from the server
+    GCancellable *cancellable;  // cancels loading when dialog is destroyed
+
+    // users completion
+    guint users_lookup_source;  // delayed lookup of users matching entry text
+    GHashTable *users_cache;    // prefix -> GArray of ESUserInfo matching it
+    char *users_pending;        // prefix being looked up on the server
+    GCancellable *users_cancellable;    // cancels lookup of users_pending
 };
 
 gboolean store_acl (struct acl_context *);
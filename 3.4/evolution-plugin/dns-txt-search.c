@@ -23,15 +23,34 @@
 #include <errno.h>
 #include <resolv.h>
 #include <string.h>
+#include <time.h>
 
 #include "dns-txt-search.h"
 
-static char * *_parse_result(const unsigned char *abuf, int alen)
+/* TXT lookups are cached per domain in memory and on disk for as long as
+ * TTL of the records allows. Domains without TXT records are cached too. */
+#define TXT_CACHE_MIN_TTL 60
+#define TXT_CACHE_MAX_TTL (24 * 60 * 60)
+#define TXT_CACHE_NEGATIVE_TTL (10 * 60)
+
+struct txt_cache_entry
+{
+    gchar * *records; // NULL if domain has no TXT records
+    gint64 expires;
+};
+
+G_LOCK_DEFINE_STATIC(txt_cache);
+static GHashTable *txt_cache = NULL; // domain -> struct txt_cache_entry
+
+static char * *_parse_result(const unsigned char *abuf, int alen, guint32 *ttl)
 {
     HEADER *hp;
     unsigned const char *p, *eom, *eor;
     char *dst, * *list;
     int ancount, qdcount, i, j, skip, type, class, len, n;
+    guint32 rttl;
+
+    *ttl = G_MAXUINT32;
 
     /*
      * Parse the header of the result.
@@ -82,6 +101,7 @@ static char * *_parse_result(const unsigned char *abuf, int alen)
         }
         type = p[skip + 0] << 8 | p[skip + 1];
         class = p[skip + 2] << 8 | p[skip + 3];
+        rttl = (guint32)p[skip + 4] << 24 | p[skip + 5] << 16 | p[skip + 6] << 8 | p[skip + 7];
         len = p[skip + 8] << 8 | p[skip + 9];
         p += skip + 10;
         if (p + len > eom)
@@ -99,6 +119,14 @@ static char * *_parse_result(const unsigned char *abuf, int alen)
             continue;
         }
 
+        /*
+         * Whole result is valid as long as the shortest lived record.
+         */
+        if (rttl < *ttl)
+        {
+            *ttl = rttl;
+        }
+
         /*
          * Allocate space for this answer.
          */
@@ -158,11 +186,17 @@ static char * *_parse_result(const unsigned char *abuf, int alen)
     return list;
 }
 
-gchar * *get_txt_records(const gchar *name)
+/* failed is set if DNS server could not be asked, missing records are
+ * a valid answer */
+static gchar * *_query_txt_records(const gchar *name, guint32 *ttl, gboolean *failed)
 {
     unsigned char qbuf[PACKETSZ], abuf[1024];
+    HEADER *hp;
+    gchar * *records;
     int n;
 
+    *failed = TRUE;
+
     if ((_res.options & RES_INIT) == 0 && res_init() == -1)
     {
         return NULL;
@@ -182,7 +216,160 @@ gchar * *get_txt_records(const gchar *name)
         return NULL;
     }
 
-    return _parse_result(abuf, n);
+    hp = (HEADER *)abuf;
+    if (n < (int)sizeof(HEADER) || (hp->rcode != NOERROR && hp->rcode != NXDOMAIN))
+    {
+        errno = ECONNREFUSED;
+        return NULL;
+    }
+
+    errno = 0;
+    records = _parse_result(abuf, n, ttl);
+    if (records || errno == ENOENT)
+    {
+        *failed = FALSE;
+    }
+
+    return records;
+}
+
+static gchar *_txt_cache_path()
+{
+    return g_build_filename(g_get_user_cache_dir(), "evolution-3e", "dns-txt-cache", NULL);
+}
+
+static void _txt_cache_entry_free(struct txt_cache_entry *entry)
+{
+    g_strfreev(entry->records);
+    g_free(entry);
+}
+
+/* Call with txt_cache lock held. Expired entries are loaded too, they are
+ * used when DNS server can't be reached. */
+static void _txt_cache_load()
+{
+    GKeyFile *kf = g_key_file_new();
+    gchar *path = _txt_cache_path();
+    gchar * *domains;
+    guint i;
+
+    txt_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)_txt_cache_entry_free);
+
+    if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL))
+    {
+        goto out;
+    }
+
+    domains = g_key_file_get_groups(kf, NULL);
+    for (i = 0; domains[i]; i++)
+    {
+        GError *err = NULL;
+        struct txt_cache_entry *entry = g_new0(struct txt_cache_entry, 1);
+
+        entry->expires = g_key_file_get_int64(kf, domains[i], "expires", &err);
+        if (err)
+        {
+            g_clear_error(&err);
+            g_free(entry);
+            continue;
+        }
+        if (g_key_file_has_key(kf, domains[i], "records", NULL))
+        {
+            entry->records = g_key_file_get_string_list(kf, domains[i], "records", NULL, NULL);
+        }
+        g_hash_table_insert(txt_cache, g_strdup(domains[i]), entry);
+    }
+    g_strfreev(domains);
+
+out:
+    g_free(path);
+    g_key_file_free(kf);
+}
+
+/* Call with txt_cache lock held. */
+static void _txt_cache_save()
+{
+    GKeyFile *kf = g_key_file_new();
+    gchar *path = _txt_cache_path();
+    gchar *dir = g_path_get_dirname(path);
+    gchar *data;
+    gsize len;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, txt_cache);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        struct txt_cache_entry *entry = value;
+
+        g_key_file_set_int64(kf, key, "expires", entry->expires);
+        if (entry->records)
+        {
+            g_key_file_set_string_list(kf, key, "records", (const gchar * const *)entry->records,
+                                       g_strv_length(entry->records));
+        }
+    }
+
+    data = g_key_file_to_data(kf, &len, NULL);
+    if (g_mkdir_with_parents(dir, 0700) == 0)
+    {
+        g_file_set_contents(path, data, len, NULL);
+    }
+
+    g_free(data);
+    g_free(dir);
+    g_free(path);
+    g_key_file_free(kf);
+}
+
+gchar * *get_txt_records(const gchar *name)
+{
+    gchar *domain = g_ascii_strdown(name, -1);
+    struct txt_cache_entry *entry;
+    gchar * *records;
+    gint64 now = time(NULL);
+    guint32 ttl;
+    gboolean failed;
+
+    G_LOCK(txt_cache);
+    if (txt_cache == NULL)
+    {
+        _txt_cache_load();
+    }
+    entry = g_hash_table_lookup(txt_cache, domain);
+    if (entry && entry->expires > now)
+    {
+        records = g_strdupv(entry->records);
+        G_UNLOCK(txt_cache);
+        g_free(domain);
+        return records;
+    }
+    G_UNLOCK(txt_cache);
+
+    records = _query_txt_records(domain, &ttl, &failed);
+
+    G_LOCK(txt_cache);
+    if (failed)
+    {
+        // offline, expired records are better than nothing
+        entry = g_hash_table_lookup(txt_cache, domain);
+        if (entry)
+        {
+            records = g_strdupv(entry->records);
+        }
+    }
+    else
+    {
+        entry = g_new0(struct txt_cache_entry, 1);
+        entry->records = g_strdupv(records);
+        entry->expires = now + (records ? CLAMP(ttl, TXT_CACHE_MIN_TTL, TXT_CACHE_MAX_TTL) : TXT_CACHE_NEGATIVE_TTL);
+        g_hash_table_replace(txt_cache, g_strdup(domain), entry);
+        _txt_cache_save();
+    }
+    G_UNLOCK(txt_cache);
+
+    g_free(domain);
+    return records;
 }
 
 gchar *get_eee_server_hostname(const gchar *email)
@@ -26,6 +26,9 @@
 
 /**
  * Get list of TXT records found on the DNS server.
+ * Results are cached in memory and in the user's cache directory for as
+ * long as TTL of the records allows. When DNS server can't be reached,
+ * expired cached records are returned.
  * @param[in] name Domain name.
  * @return Array of strings. Free it using g_strfreev().
  */
@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <libedataserverui/e-passwords.h>
 
 #include "dns-txt-search.h"
@@ -35,8 +36,39 @@ struct _EeeAccountPriv
     xr_client_conn *conn;
     gboolean is_authorized;
     GArray *cals;
+    GHashTable *realnames;  /* username -> struct realname_entry */
+    guint idle_timeout;     /* source id of idle disconnect timer */
+    gboolean is_reused;     /* connection was authorized by earlier operation */
+    time_t last_used;       /* when connection was used last (async worker) */
+    EeeAccount *worker;     /* copy of the account used by async_pool thread */
+    GThreadPool *async_pool; /* runs async operations one by one */
+    gboolean is_worker;     /* account is the async worker copy, it must not prompt */
+    char *password;         /* password for the async worker, got in the main loop */
+    char *async_password;   /* password passed to async tasks, read from the keyring once */
+    guint worker_idle_timeout; /* source id of timer closing idle worker connection */
+    time_t worker_idle_since; /* when worker_idle_timeout was started */
+    gboolean needs_auth;    /* async worker has no valid password */
 };
 
+/* Connection is kept open between operations and closed after being unused
+ * for this long (seconds). */
+#define EEE_CONNECTION_IDLE_TIMEOUT 300
+
+/* How long are cached user realnames considered valid (seconds). */
+#define REALNAME_CACHE_TTL 600
+
+struct realname_entry
+{
+    char *realname;     /* NULL if user has no realname */
+    time_t fetched;
+};
+
+static void realname_entry_free(struct realname_entry *entry)
+{
+    g_free(entry->realname);
+    g_free(entry);
+}
+
 EeeAccount *eee_account_new(const char *name)
 {
     EeeAccount *self = g_object_new(EEE_TYPE_ACCOUNT, NULL);
@@ -117,6 +149,38 @@ gboolean eee_account_find_server(EeeAccount *self)
 
 /* communication functions */
 
+/* Called after ESClient call on the account connection failed. Connection
+ * kept open from earlier operation may have been closed by the server
+ * meanwhile, so reconnect and return TRUE to let the caller repeat the call.
+ * Errors reported by the server about the call itself are not retried.
+ * The failed call may still have been executed by the server, so callers
+ * repeating calls that are not idempotent must treat the error saying the
+ * work is already done as success. */
+static gboolean eee_account_retry(EeeAccount *self, GError **err)
+{
+    if (*err == NULL || !self->priv->is_reused)
+    {
+        return FALSE;
+    }
+
+    if ((*err)->code == ES_XMLRPC_ERROR_AUTH_FAILED ||
+        (*err)->code == ES_XMLRPC_ERROR_INVALID_PARAMETER ||
+        ((*err)->code > ES_XMLRPC_ERROR_NO_EFFECTIVE_USER && (*err)->code != ES_XMLRPC_ERROR_CLIENT_ERROR))
+    {
+        return FALSE;
+    }
+
+    g_warning("** EEE ** Call failed on reused connection for account '%s', reconnecting. (%d:%s)", self->name, (*err)->code, (*err)->message);
+    eee_account_disconnect(self);
+    if (!eee_account_auth(self))
+    {
+        return FALSE;
+    }
+
+    g_clear_error(err);
+    return TRUE;
+}
+
 static gboolean remove_acl(xr_client_conn *conn, const char *calname)
 {
     GError *err = NULL;
@@ -280,6 +344,10 @@ gboolean eee_account_load_calendars(EeeAccount *self, GArray * *cals)
     eee_account_free_calendars_list(self->priv->cals);
 
     self->priv->cals = ESClient_getCalendars(self->priv->conn, "", &err);
+    if (eee_account_retry(self, &err))
+    {
+        self->priv->cals = ESClient_getCalendars(self->priv->conn, "", &err);
+    }
     if (err)
     {
         g_warning("** EEE ** Failed to get calendars for account '%s'. (%d:%s)", self->name, err->code, err->message);
@@ -309,6 +377,10 @@ static char *create_users_query(EeeAccount *self, const char *realname)
     char *query = g_strdup_printf("match_user_attribute_prefix('realname', %s)", realname);
     GError *err = NULL;
     GArray *users = ESClient_getUsers(self->priv->conn, query, &err);
+    if (eee_account_retry(self, &err))
+    {
+        users = ESClient_getUsers(self->priv->conn, query, &err);
+    }
     g_free(query);
     if (err)
     {
@@ -342,6 +414,30 @@ gboolean eee_account_search_shared_calendars(EeeAccount *self, const char *query
     char *query = NULL;
     gboolean retval;
 
+    if (query_string != NULL && query_string[0] != '\0' && cals != NULL && eee_account_auth(self))
+    {
+        GError *err = NULL;
+
+        /* server matches usernames, realnames, calendar names and titles in one call */
+        *cals = ESClient_searchCalendars(self->priv->conn, query_string, 0, 0, &err);
+        if (eee_account_retry(self, &err))
+        {
+            *cals = ESClient_searchCalendars(self->priv->conn, query_string, 0, 0, &err);
+        }
+        if (err == NULL)
+        {
+            return TRUE;
+        }
+        if (err->code != ES_XMLRPC_ERROR_INVALID_METHOD)
+        {
+            g_warning("** EEE ** Failed to search calendars for account '%s'. (%d:%s)", self->name, err->code, err->message);
+            g_clear_error(&err);
+            return FALSE;
+        }
+        /* older server, fall back to prefix matching queries */
+        g_clear_error(&err);
+    }
+
     if (query_string != NULL && query_string[0] != '\0')
     {
         char *escaped_query = qp_escape_string(query_string);
@@ -361,6 +457,43 @@ gboolean eee_account_search_shared_calendars(EeeAccount *self, const char *query
     return retval;
 }
 
+gboolean eee_account_search_shared_calendars_page(EeeAccount *self, const char *prefix, guint offset, guint limit, GArray * *cals)
+{
+    GError *err = NULL;
+
+    if (prefix == NULL || cals == NULL || !eee_account_auth(self))
+    {
+        return FALSE;
+    }
+
+    *cals = ESClient_searchCalendars(self->priv->conn, prefix, offset, limit, &err);
+    if (eee_account_retry(self, &err))
+    {
+        *cals = ESClient_searchCalendars(self->priv->conn, prefix, offset, limit, &err);
+    }
+    if (err == NULL)
+    {
+        return TRUE;
+    }
+
+    if (err->code != ES_XMLRPC_ERROR_INVALID_METHOD)
+    {
+        g_warning("** EEE ** Failed to search calendars for account '%s'. (%d:%s)", self->name, err->code, err->message);
+        g_clear_error(&err);
+        return FALSE;
+    }
+    g_clear_error(&err);
+
+    /* older server can't page results, first page gets all of them */
+    if (offset > 0)
+    {
+        *cals = g_array_new(FALSE, TRUE, sizeof(ESCalendarInfo *));
+        return TRUE;
+    }
+
+    return eee_account_search_shared_calendars(self, prefix, cals);
+}
+
 gboolean eee_account_get_shared_calendars(EeeAccount *self, const char *query, GArray * *cals)
 {
     GError *err = NULL;
@@ -371,6 +504,10 @@ gboolean eee_account_get_shared_calendars(EeeAccount *self, const char *query, G
     }
 
     *cals = ESClient_getSharedCalendars(self->priv->conn, query, &err);
+    if (eee_account_retry(self, &err))
+    {
+        *cals = ESClient_getSharedCalendars(self->priv->conn, query, &err);
+    }
     if (err)
     {
         g_warning("** EEE ** Failed to get calendars for account '%s'. (%d:%s)", self->name, err->code, err->message);
@@ -396,6 +533,10 @@ gboolean eee_account_get_user_attributes(EeeAccount *self, const char *username,
     }
 
     *attrs = ESClient_getUserAttributes(self->priv->conn, username, &err);
+    if (eee_account_retry(self, &err))
+    {
+        *attrs = ESClient_getUserAttributes(self->priv->conn, username, &err);
+    }
     if (err)
     {
         g_warning("** EEE ** Failed to get calendars for account '%s'. (%d:%s)", self->name, err->code, err->message);
@@ -406,6 +547,121 @@ gboolean eee_account_get_user_attributes(EeeAccount *self, const char *username,
     return TRUE;
 }
 
+static void realname_cache_set(EeeAccount *self, const char *username, GArray *attrs)
+{
+    struct realname_entry *entry = g_new0(struct realname_entry, 1);
+
+    entry->realname = g_strdup(eee_find_attribute_value(attrs, "realname"));
+    entry->fetched = time(NULL);
+    g_hash_table_replace(self->priv->realnames, g_strdup(username), entry);
+}
+
+static gboolean realname_cache_valid(EeeAccount *self, const char *username)
+{
+    struct realname_entry *entry = g_hash_table_lookup(self->priv->realnames, username);
+
+    return entry && time(NULL) - entry->fetched < REALNAME_CACHE_TTL;
+}
+
+/* Load realnames of given users that are not cached yet using single
+ * getUsersAttributes call. Servers without batch call are asked for each
+ * user separately. */
+gboolean eee_account_prefetch_realnames(EeeAccount *self, GSList *usernames)
+{
+    GError *err = NULL;
+    GSList *iter;
+    GSList *missing = NULL;
+    GArray *names;
+    GArray *infos;
+    guint i;
+
+    for (iter = usernames; iter; iter = iter->next)
+    {
+        if (!realname_cache_valid(self, iter->data) && !g_slist_find_custom(missing, iter->data, (GCompareFunc)g_strcmp0))
+        {
+            missing = g_slist_prepend(missing, iter->data);
+        }
+    }
+
+    if (missing == NULL)
+    {
+        return TRUE;
+    }
+
+    if (!eee_account_auth(self))
+    {
+        g_slist_free(missing);
+        return FALSE;
+    }
+
+    names = g_array_new(FALSE, TRUE, sizeof(char *));
+    for (iter = missing; iter; iter = iter->next)
+    {
+        char *name = g_strdup(iter->data);
+        g_array_append_val(names, name);
+    }
+
+    infos = ESClient_getUsersAttributes(self->priv->conn, names, &err);
+    if (eee_account_retry(self, &err))
+    {
+        infos = ESClient_getUsersAttributes(self->priv->conn, names, &err);
+    }
+    Array_string_free(names);
+
+    if (err == NULL)
+    {
+        for (i = 0; i < infos->len; i++)
+        {
+            ESUserInfo *info = g_array_index(infos, ESUserInfo *, i);
+            realname_cache_set(self, info->username, info->attrs);
+        }
+        Array_ESUserInfo_free(infos);
+
+        /* users unknown to the server have no realname either */
+        for (iter = missing; iter; iter = iter->next)
+        {
+            if (!realname_cache_valid(self, iter->data))
+            {
+                realname_cache_set(self, iter->data, NULL);
+            }
+        }
+
+        g_slist_free(missing);
+        return TRUE;
+    }
+
+    if (err->code != ES_XMLRPC_ERROR_INVALID_METHOD)
+    {
+        g_warning("** EEE ** Failed to get users attributes for account '%s'. (%d:%s)", self->name, err->code, err->message);
+        g_clear_error(&err);
+        g_slist_free(missing);
+        return FALSE;
+    }
+    g_clear_error(&err);
+
+    for (iter = missing; iter; iter = iter->next)
+    {
+        GArray *attrs = NULL;
+
+        if (eee_account_get_user_attributes(self, iter->data, &attrs))
+        {
+            realname_cache_set(self, iter->data, attrs);
+            eee_account_free_attributes_list(attrs);
+        }
+    }
+
+    g_slist_free(missing);
+    return TRUE;
+}
+
+/* Get cached realname of the user, NULL if unknown. */
+const char *eee_account_peek_realname(EeeAccount *self, const char *username)
+{
+    struct realname_entry *entry = g_hash_table_lookup(self->priv->realnames, username);
+
+    return entry ? entry->realname : NULL;
+}
+
 void eee_account_free_attributes_list(GArray *l)
 {
     Array_ESAttribute_free (l);
@@ -420,6 +676,10 @@ gboolean eee_account_set_calendar_attribute(EeeAccount *self, const char *owner,
 
     char *calspec = g_strdup_printf("%s:%s", owner, calname);
     ESClient_setCalendarAttribute(self->priv->conn, calspec, name, value ? value : "", is_public, &err);
+    if (eee_account_retry(self, &err))
+    {
+        ESClient_setCalendarAttribute(self->priv->conn, calspec, name, value ? value : "", is_public, &err);
+    }
     g_free(calspec);
 
     if (err)
@@ -462,6 +722,15 @@ gboolean eee_account_create_new_calendar(EeeAccount *self, char * *calname)
     {
         *calname = generate_calname();
         ESClient_createCalendar(self->priv->conn, *calname, &err);
+        if (eee_account_retry(self, &err))
+        {
+            ESClient_createCalendar(self->priv->conn, *calname, &err);
+            // first call created the calendar before connection was lost
+            if (err && err->code == ES_XMLRPC_ERROR_CALENDAR_EXISTS)
+            {
+                g_clear_error(&err);
+            }
+        }
         if (err == NULL || err->code != ES_XMLRPC_ERROR_CALENDAR_EXISTS)
         {
             break;
@@ -493,6 +762,14 @@ gboolean eee_account_unsubscribe_calendar(EeeAccount *self, const char *owner, c
 
     char *calspec = g_strdup_printf("%s:%s", owner, calname);
     ESClient_unsubscribeCalendar(self->priv->conn, calspec, &err);
+    if (eee_account_retry(self, &err))
+    {
+        ESClient_unsubscribeCalendar(self->priv->conn, calspec, &err);
+        if (err && err->code == ES_XMLRPC_ERROR_NOT_SUBSCRIBED)
+        {
+            g_clear_error(&err);
+        }
+    }
     g_free(calspec);
 
     if (err)
@@ -516,6 +793,14 @@ gboolean eee_account_subscribe_calendar(EeeAccount *self, const char *owner, con
 
     char *calspec = g_strdup_printf("%s:%s", owner, calname);
     ESClient_subscribeCalendar(self->priv->conn, calspec, &err);
+    if (eee_account_retry(self, &err))
+    {
+        ESClient_subscribeCalendar(self->priv->conn, calspec, &err);
+        if (err && err->code == ES_XMLRPC_ERROR_ALREADY_SUBSCRIBED)
+        {
+            g_clear_error(&err);
+        }
+    }
     g_free(calspec);
 
     if (err)
@@ -538,6 +823,14 @@ gboolean eee_account_delete_calendar(EeeAccount *self, const char *calname)
     }
 
     ESClient_deleteCalendar(self->priv->conn, calname, &err);
+    if (eee_account_retry(self, &err))
+    {
+        ESClient_deleteCalendar(self->priv->conn, calname, &err);
+        if (err && err->code == ES_XMLRPC_ERROR_UNKNOWN_CALENDAR)
+        {
+            g_clear_error(&err);
+        }
+    }
 
     if (err)
     {
@@ -560,30 +853,35 @@ gboolean eee_account_delete_calendar(EeeAccount *self, const char *calname)
  *   - 1 = G_TYPE_STRING (realname)
  *   - 2 = EEE_TYPE_ACCOUNT (self object passed as @b self parameter)
  */
-gboolean eee_account_load_users(EeeAccount *self, char *prefix, GSList *exclude_users, GtkListStore *model)
+/* Get list of users whose username starts with prefix (all users if prefix is
+ * NULL or empty). Does not touch GTK, so it's usable from async operations. */
+gboolean eee_account_get_users(EeeAccount *self, const char *prefix, GArray * *users)
 {
     GError *err = NULL;
-    GArray *users;
-    guint i;
-    GtkTreeIter titer_user;
+    char *query;
 
-    if (!eee_account_auth(self))
+    if (users == NULL || !eee_account_auth(self))
     {
         return FALSE;
     }
 
     if (prefix == NULL || prefix[0] == '\0')
     {
-        users = ESClient_getUsers(self->priv->conn, "", &err);
+        query = g_strdup("");
     }
     else
     {
         char *escaped_prefix = qp_escape_string(prefix);
-        char *query = g_strdup_printf("match_username_prefix(%s)", escaped_prefix);
+        query = g_strdup_printf("match_username_prefix(%s)", escaped_prefix);
         g_free(escaped_prefix);
-        users = ESClient_getUsers(self->priv->conn, query, &err);
-        g_free(query);
     }
+
+    *users = ESClient_getUsers(self->priv->conn, query, &err);
+    if (eee_account_retry(self, &err))
+    {
+        *users = ESClient_getUsers(self->priv->conn, query, &err);
+    }
+    g_free(query);
     if (err)
     {
         g_warning("** EEE ** Failed to get users list for user '%s'. (%d:%s)", self->name, err->code, err->message);
@@ -591,6 +889,28 @@ gboolean eee_account_load_users(EeeAccount *self, char *prefix, GSList *exclude_
         return FALSE;
     }
 
+    return TRUE;
+}
+
+gboolean eee_account_load_users(EeeAccount *self, char *prefix, GSList *exclude_users, GtkListStore *model)
+{
+    GArray *users;
+    GHashTable *exclude;
+    GSList *iter;
+    guint i;
+    GtkTreeIter titer_user;
+
+    if (!eee_account_get_users(self, prefix, &users))
+    {
+        return FALSE;
+    }
+
+    exclude = g_hash_table_new(g_str_hash, g_str_equal);
+    for (iter = exclude_users; iter; iter = iter->next)
+    {
+        g_hash_table_insert(exclude, iter->data, iter->data);
+    }
+
     for (i = 0; i < users->len; i++)
     {
         ESUserInfo *user = g_array_index (users, ESUserInfo *, i);
@@ -599,7 +919,7 @@ gboolean eee_account_load_users(EeeAccount *self, char *prefix, GSList *exclude_
         if (!g_strcmp0(self->name, user->username))
             continue;
 
-        if (exclude_users && g_slist_find_custom(exclude_users, user->username, (GCompareFunc)g_strcmp0))
+        if (g_hash_table_lookup(exclude, user->username))
             continue;
 
         gtk_list_store_append(model, &titer_user);
@@ -610,17 +930,79 @@ gboolean eee_account_load_users(EeeAccount *self, char *prefix, GSList *exclude_
                            -1);
     }
 
+    g_hash_table_destroy(exclude);
     Array_ESUserInfo_free (users);
 
     return TRUE;
 }
 
+/* Ask user for the password of the account, must be called from the main
+ * loop. Returns NULL if user cancelled the dialog. */
+static char *eee_account_ask_password(EeeAccount *self, const char *fail_msg, guint32 flags)
+{
+    GConfClient *gconf = gconf_client_get_default();
+    char *key = g_strdup_printf("eee://%s", self->name);
+    char *path = g_strdup_printf(EEE_KEY "accounts/%s/remember_password", self->name);
+    gboolean remember = gconf_client_get_bool(gconf, path, NULL);
+    char *prompt = g_strdup_printf("%sEnter password for your 3e calendar account: %s.", fail_msg, self->name);
+    char *password;
+
+    // key must have uri format or unpatched evolution segfaults in
+    // ep_get_password_keyring()
+    password = e_passwords_ask_password(prompt, EEE_PASSWORD_COMPONENT, key, prompt, flags, &remember, NULL);
+    gconf_client_set_bool(gconf, path, remember, NULL);
+    g_free(path);
+    g_object_unref(gconf);
+    g_free(prompt);
+    g_free(key);
+
+    return password;
+}
+
+/* Authenticate async worker using password passed from the main loop. If
+ * there is none or it's rejected, needs_auth is set and the main loop asks
+ * user for the password. */
+static gboolean eee_account_auth_worker(EeeAccount *self)
+{
+    GError *err = NULL;
+    gboolean rs;
+
+    if (self->priv->password == NULL)
+    {
+        self->priv->needs_auth = TRUE;
+        return FALSE;
+    }
+
+    rs = ESClient_authenticate(self->priv->conn, self->name, self->priv->password, &err);
+    if (!err && rs == TRUE)
+    {
+        self->priv->is_authorized = TRUE;
+        self->priv->is_reused = FALSE;
+        return TRUE;
+    }
+
+    if (err)
+    {
+        g_warning("** EEE ** Authentization failed for user '%s'. (%d:%s)", self->name, err->code, err->message);
+        if (err->code == ES_XMLRPC_ERROR_AUTH_FAILED)
+        {
+            self->priv->needs_auth = TRUE;
+        }
+        g_clear_error(&err);
+    }
+    else
+    {
+        g_warning("** EEE ** Authentization failed for user '%s' without error.", self->name);
+        self->priv->needs_auth = TRUE;
+    }
+
+    return FALSE;
+}
+
 gboolean eee_account_auth(EeeAccount *self)
 {
     GError *err = NULL;
     guint32 flags = E_PASSWORDS_REMEMBER_FOREVER | E_PASSWORDS_SECRET;
-    GConfClient *gconf;
-    gboolean remember = TRUE;
     char *fail_msg = "";
     char *password;
     int retry_limit = 3;
@@ -633,9 +1015,16 @@ gboolean eee_account_auth(EeeAccount *self)
     }
     if (self->priv->is_authorized)
     {
+        self->priv->is_reused = TRUE;
         return TRUE;
     }
 
+    /* async worker runs outside of the main loop, it can't prompt */
+    if (self->priv->is_worker)
+    {
+        return eee_account_auth_worker(self);
+    }
+
     key = g_strdup_printf("eee://%s", self->name);
     password = e_passwords_get_password(EEE_PASSWORD_COMPONENT, key);
 
@@ -643,17 +1032,7 @@ gboolean eee_account_auth(EeeAccount *self)
     {
         if (password == NULL)
         {
-            gconf = gconf_client_get_default();
-            char *path = g_strdup_printf(EEE_KEY "accounts/%s/remember_password", self->name);
-            remember = gconf_client_get_bool(gconf, path, NULL);
-            char *prompt = g_strdup_printf("%sEnter password for your 3e calendar account: %s.", fail_msg, self->name);
-            // key must have uri format or unpatched evolution segfaults in
-            // ep_get_password_keyring()
-            password = e_passwords_ask_password(prompt, EEE_PASSWORD_COMPONENT, key, prompt, flags, &remember, NULL);
-            gconf_client_set_bool(gconf, path, remember, NULL);
-            g_free(path);
-            g_object_unref(gconf);
-            g_free(prompt);
+            password = eee_account_ask_password(self, fail_msg, flags);
             if (password == NULL)
             {
                 goto err;
@@ -666,6 +1045,7 @@ gboolean eee_account_auth(EeeAccount *self)
         if (!err && rs == TRUE)
         {
             self->priv->is_authorized = TRUE;
+            self->priv->is_reused = FALSE;
             g_free(key);
             return TRUE;
         }
@@ -711,6 +1091,12 @@ xr_client_conn *eee_account_connect(EeeAccount *self)
         return NULL;
     }
 
+    if (self->priv->idle_timeout)
+    {
+        g_source_remove(self->priv->idle_timeout);
+        self->priv->idle_timeout = 0;
+    }
+
     if (self->priv->conn)
     {
         return self->priv->conn;
@@ -756,12 +1142,240 @@ void eee_account_disconnect(EeeAccount *self)
 {
     g_return_if_fail(IS_EEE_ACCOUNT(self));
 
+    if (self->priv->idle_timeout)
+    {
+        g_source_remove(self->priv->idle_timeout);
+        self->priv->idle_timeout = 0;
+    }
     if (self->priv->conn)
     {
         xr_client_free(self->priv->conn);
     }
     self->priv->conn = NULL;
     self->priv->is_authorized = FALSE;
+    self->priv->is_reused = FALSE;
+}
+
+static gboolean idle_disconnect_cb(EeeAccount *self)
+{
+    self->priv->idle_timeout = 0;
+    eee_account_disconnect(self);
+    return FALSE;
+}
+
+/* Tell account that current operation is done. Authorized connection is kept
+ * open for next operations and closed after EEE_CONNECTION_IDLE_TIMEOUT
+ * seconds of inactivity. Must be called from the main loop thread, not for
+ * the async worker, whose connection is closed by worker_idle_cb(). */
+void eee_account_release(EeeAccount *self)
+{
+    g_return_if_fail(IS_EEE_ACCOUNT(self));
+    g_return_if_fail(!self->priv->is_worker);
+
+    if (self->priv->conn == NULL)
+    {
+        return;
+    }
+
+    if (self->priv->idle_timeout)
+    {
+        g_source_remove(self->priv->idle_timeout);
+    }
+    self->priv->idle_timeout = g_timeout_add_seconds(EEE_CONNECTION_IDLE_TIMEOUT, (GSourceFunc)idle_disconnect_cb, self);
+}
+
+/* async operations */
+
+/* How many times is user asked for the password of async operation. */
+#define ASYNC_AUTH_ATTEMPTS 3
+
+struct async_task
+{
+    EeeAccount *account;
+    char *server;
+    char *password;             /* NULL if not stored, worker then needs auth */
+    gboolean needs_auth;        /* worker could not authenticate */
+    int auth_attempts;
+    EeeAccountAsyncFunc func;
+    EeeAccountAsyncDone done;
+    gpointer data;
+    GDestroyNotify data_free;
+    GCancellable *cancellable;
+    gboolean is_disconnect;     /* only closes idle connection of the worker */
+    time_t idle_since;          /* disconnect only if worker wasn't used since */
+};
+
+static gboolean worker_idle_cb(EeeAccount *self);
+
+/* (Re)start timer closing connection of the worker after it has been unused
+ * for EEE_CONNECTION_IDLE_TIMEOUT seconds, runs in the main loop. */
+static void worker_schedule_idle_disconnect(EeeAccount *self)
+{
+    if (self->priv->worker_idle_timeout)
+    {
+        g_source_remove(self->priv->worker_idle_timeout);
+    }
+    self->priv->worker_idle_timeout = g_timeout_add_seconds(EEE_CONNECTION_IDLE_TIMEOUT, (GSourceFunc)worker_idle_cb, self);
+    self->priv->worker_idle_since = time(NULL);
+}
+
+/* Worker connection may only be touched by the async_pool thread, so queue
+ * task that closes it there. */
+static gboolean worker_idle_cb(EeeAccount *self)
+{
+    struct async_task *task;
+
+    self->priv->worker_idle_timeout = 0;
+
+    task = g_new0(struct async_task, 1);
+    task->account = g_object_ref(self);
+    task->is_disconnect = TRUE;
+    task->idle_since = self->priv->worker_idle_since;
+    g_thread_pool_push(self->priv->async_pool, task, NULL);
+
+    return FALSE;
+}
+
+/* deliver result of async operation, runs in the main loop */
+static gboolean async_task_complete(struct async_task *task)
+{
+    /* worker can't prompt, so ask for the password here and run the
+     * operation again */
+    if (task->needs_auth && task->auth_attempts < ASYNC_AUTH_ATTEMPTS &&
+        !g_cancellable_is_cancelled(task->cancellable))
+    {
+        guint32 flags = E_PASSWORDS_REMEMBER_FOREVER | E_PASSWORDS_SECRET;
+        char *fail_msg = "";
+        char *password;
+
+        if (task->password)
+        {
+            char *key = g_strdup_printf("eee://%s", task->account->name);
+            e_passwords_forget_password(EEE_PASSWORD_COMPONENT, key);
+            g_free(key);
+            flags |= E_PASSWORDS_REPROMPT;
+            fail_msg = "Invalid password. ";
+        }
+        g_free(task->account->priv->async_password);
+        task->account->priv->async_password = NULL;
+
+        task->auth_attempts++;
+        password = eee_account_ask_password(task->account, fail_msg, flags);
+        if (password)
+        {
+            task->account->priv->async_password = g_strdup(password);
+            g_free(task->password);
+            task->password = password;
+            task->needs_auth = FALSE;
+            g_thread_pool_push(task->account->priv->async_pool, task, NULL);
+            return FALSE;
+        }
+    }
+
+    if (task->done && !g_cancellable_is_cancelled(task->cancellable))
+    {
+        task->done(task->account, task->data);
+    }
+
+    if (!task->is_disconnect)
+    {
+        worker_schedule_idle_disconnect(task->account);
+    }
+
+    if (task->data_free)
+    {
+        task->data_free(task->data);
+    }
+    if (task->cancellable)
+    {
+        g_object_unref(task->cancellable);
+    }
+    g_free(task->server);
+    g_free(task->password);
+    g_object_unref(task->account);
+    g_free(task);
+
+    return FALSE;
+}
+
+static void async_worker_func(struct async_task *task, EeeAccount *self)
+{
+    EeeAccount *worker = self->priv->worker;
+
+    if (task->is_disconnect)
+    {
+        /* operations queued meanwhile have used the connection again */
+        if (worker->priv->conn && worker->priv->last_used <= task->idle_since)
+        {
+            eee_account_disconnect(worker);
+        }
+    }
+    else if (!g_cancellable_is_cancelled(task->cancellable))
+    {
+        if (worker->server == NULL)
+        {
+            worker->server = g_strdup(task->server);
+        }
+
+        /* server has probably closed the connection already */
+        if (worker->priv->conn && time(NULL) - worker->priv->last_used > EEE_CONNECTION_IDLE_TIMEOUT)
+        {
+            eee_account_disconnect(worker);
+        }
+
+        g_free(worker->priv->password);
+        worker->priv->password = g_strdup(task->password);
+        worker->priv->needs_auth = FALSE;
+
+        task->func(worker, task->data, task->cancellable);
+        worker->priv->last_used = time(NULL);
+        task->needs_auth = worker->priv->needs_auth;
+    }
+
+    g_idle_add((GSourceFunc)async_task_complete, task);
+}
+
+/* Run func in the background thread of the account, operations of one
+ * account are run one after another on their own copy of the account with
+ * separate connection. func gets that copy and must not touch GTK. Then done
+ * is called in the main loop with the original account, unless cancellable
+ * was cancelled meanwhile. data_free is always called in the main loop at
+ * the end. Worker never prompts for the password, if it has none or it's
+ * wrong, user is asked in the main loop and func is run again. The password
+ * is read from the keyring only once, not for every operation. */
+void eee_account_run_async(EeeAccount *self, EeeAccountAsyncFunc func, EeeAccountAsyncDone done,
+                           gpointer data, GDestroyNotify data_free, GCancellable *cancellable)
+{
+    struct async_task *task;
+    char *key;
+
+    g_return_if_fail(IS_EEE_ACCOUNT(self));
+    g_return_if_fail(func != NULL);
+
+    if (self->priv->async_pool == NULL)
+    {
+        self->priv->worker = eee_account_new(self->name);
+        self->priv->worker->priv->is_worker = TRUE;
+        self->priv->async_pool = g_thread_pool_new((GFunc)async_worker_func, self, 1, FALSE, NULL);
+    }
+
+    task = g_new0(struct async_task, 1);
+    task->account = g_object_ref(self);
+    task->server = g_strdup(self->server);
+    if (self->priv->async_password == NULL)
+    {
+        key = g_strdup_printf("eee://%s", self->name);
+        self->priv->async_password = e_passwords_get_password(EEE_PASSWORD_COMPONENT, key);
+        g_free(key);
+    }
+    task->password = g_strdup(self->priv->async_password);
+    task->func = func;
+    task->done = done;
+    task->data = data;
+    task->data_free = data_free;
+    task->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+
+    g_thread_pool_push(self->priv->async_pool, task, NULL);
 }
 
 /* GObject foo */
@@ -772,6 +1386,7 @@ static void eee_account_init(EeeAccount *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self, EEE_TYPE_ACCOUNT, EeeAccountPriv);
     self->priv->cals = NULL;
+    self->priv->realnames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)realname_entry_free);
 }
 
 static void eee_account_dispose(GObject *object)
@@ -788,10 +1403,21 @@ static void eee_account_finalize(GObject *object)
 
     g_free(self->name);
     g_free(self->server);
-    if (self->priv->conn)
-        xr_client_free(self->priv->conn);
+    eee_account_disconnect(self);
+    if (self->priv->worker_idle_timeout)
+    {
+        g_source_remove(self->priv->worker_idle_timeout);
+    }
+    if (self->priv->async_pool)
+    {
+        g_thread_pool_free(self->priv->async_pool, TRUE, TRUE);
+        g_object_unref(self->priv->worker);
+    }
+    g_free(self->priv->password);
+    g_free(self->priv->async_password);
 
     Array_ESCalendarInfo_free (self->priv->cals);
+    g_hash_table_destroy(self->priv->realnames);
 
     G_OBJECT_CLASS(eee_account_parent_class)->finalize(object);
 }
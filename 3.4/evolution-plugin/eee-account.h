@@ -67,6 +67,11 @@ enum _EeeAccountState
                                   after unsuccessfull login) */
 };
 
+/** Async operation, runs in background thread with the account copy. */
+typedef void (*EeeAccountAsyncFunc)(EeeAccount *worker, gpointer data, GCancellable *cancellable);
+/** Async operation completion, runs in the main loop with the original account. */
+typedef void (*EeeAccountAsyncDone)(EeeAccount *self, gpointer data);
+
 G_BEGIN_DECLS
 
 GType eee_account_get_type() G_GNUC_CONST;
@@ -85,9 +90,19 @@ void              eee_account_dump(EeeAccount *self);
 gboolean          eee_account_auth(EeeAccount *self);
 xr_client_conn *eee_account_connect(EeeAccount *self);
 void              eee_account_disconnect(EeeAccount *self);
+void              eee_account_release(EeeAccount *self);
+void              eee_account_run_async(EeeAccount *self,
+                                        EeeAccountAsyncFunc func,
+                                        EeeAccountAsyncDone done,
+                                        gpointer data,
+                                        GDestroyNotify data_free,
+                                        GCancellable *cancellable);
 gboolean          eee_account_find_server(EeeAccount *self);
 gboolean          eee_account_load_calendars(EeeAccount *self, GArray * *cals);
 GArray *eee_account_peek_calendars(EeeAccount *self);
+gboolean          eee_account_get_users(EeeAccount *self,
+                                        const char *prefix,
+                                        GArray * *users);
 gboolean          eee_account_load_users(EeeAccount *self,
                                          char *prefix,
                                          GSList *exclude_users,
@@ -103,6 +118,10 @@ gboolean          eee_account_calendar_acl_set_shared(EeeAccount *self,
 gboolean          eee_account_get_user_attributes(EeeAccount *self,
                                                   const char *username,
                                                   GArray * *attrs);
+gboolean          eee_account_prefetch_realnames(EeeAccount *self,
+                                                 GSList *usernames);
+const char       *eee_account_peek_realname(EeeAccount *self,
+                                            const char *username);
 void              eee_account_free_attributes_list(GArray *l);
 gboolean          eee_account_set_calendar_attribute(EeeAccount *self,
                                                      const char *owner,
@@ -128,6 +147,11 @@ gboolean          eee_account_delete_calendar(EeeAccount *self,
 gboolean          eee_account_search_shared_calendars(EeeAccount *self,
                                                       const char *query,
                                                       GArray * *cals);
+gboolean          eee_account_search_shared_calendars_page(EeeAccount *self,
+                                                           const char *prefix,
+                                                           guint offset,
+                                                           guint limit,
+                                                           GArray * *cals);
 gboolean          eee_account_get_shared_calendars(EeeAccount *self,
                                                    const char *query,
                                                    GArray * *cals);
@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <time.h>
 #include <libedataserver/e-account-list.h>
 
 #include "dns-txt-search.h"
@@ -32,7 +33,8 @@
 #include "utils.h"
 
 #define CALENDAR_SOURCES "/apps/evolution/calendar/sources"
-#define EEE_KEY "/apps/evolution/calendar/eee/"
+#define EEE_DIR "/apps/evolution/calendar/eee"
+#define EEE_KEY EEE_DIR "/"
 
 /* How this stuff works:
  *
@@ -71,11 +73,16 @@ struct _EeeAccountsManagerPriv
     ESourceList *eslist;        /**< Source list for calendar. */
     GSList *access_accounts;    /**< List of names of accessible accounts (user can connect to). */
     GSList *accounts;           /**< List of EeeAccount obejcts managed by this EeeAccountsManager. */
+    GHashTable *disabled_accounts; /**< Set of names of disabled accounts, mirrors gconf. */
+    GMutex *disabled_lock;      /**< Protects disabled_accounts, used by sync thread too. */
+    guint disabled_notify;      /**< Gconf notification id for disabled_accounts. */
 
     // calendar list synchronization thread
     GThread *sync_thread;       /**< Synchronization thread. */
     volatile gint sync_request; /**< Synchronization request. */
     GSList *sync_accounts;      /**< List of account objects loaded by sync thrad. */
+    GThreadPool *sync_pool;     /**< Workers contacting servers of sync_accounts. */
+    GMutex *sync_lock;          /**< Protects state of sync tasks. */
 };
 
 /* idle runner */
@@ -130,9 +137,10 @@ static void run_idle(GSourceFunc func, gpointer data)
  *   (this is necessary because there is no easy way to protect EeeAccount from
  *   being accessed by main thread while it is manipulated by sync thread)
  * - sync thread runs eee_accounts_manager_sync_phase1() which will contact eee
- *   servers and load data
- * - sync thread runs sync_completer() in the main loop which will take
- *   sync_accounts list and merge it into ESourceList
+ *   servers and load data using worker pool, every account is merged into
+ *   ESourceList in the main loop as soon as it's loaded
+ * - sync thread runs sync_completer() in the main loop which will remove
+ *   sources that were not found on any server
  */
 
 enum
@@ -144,6 +152,30 @@ enum
     SYNC_REQ_STOP
 };
 
+/* Maximal number of accounts synchronized at once and time after which
+ * account is given up for current sync run (seconds). */
+#define SYNC_WORKERS 4
+#define SYNC_ACCOUNT_TIMEOUT 60
+
+enum
+{
+    SYNC_TASK_QUEUED,
+    SYNC_TASK_RUNNING,
+    SYNC_TASK_DONE,
+    SYNC_TASK_ABANDONED
+};
+
+/* one account synchronized by the sync worker pool */
+struct sync_task
+{
+    volatile gint refs;
+    EeeAccountsManager *mgr;
+    EeeAccount *account;        /**< Account copy, modified by worker only. */
+    GAsyncQueue *results;       /**< Queue to put task into when done. */
+    int state;                  /**< Protected by sync_lock. */
+    time_t started;             /**< Protected by sync_lock. */
+};
+
 /* prepare sync_accounts list for sync pahse1 */
 static gboolean sync_starter(gpointer data)
 {
@@ -256,73 +288,235 @@ void eee_accounts_manager_pause_sync(EeeAccountsManager *self)
     g_atomic_int_set(&self->priv->sync_request, SYNC_REQ_PAUSE);
 }
 
-/* synchronization phase1 (load data from the server) */
+/* synchronization phase1 (load data from the server)
+ *
+ * Accounts are processed concurrently in the sync worker pool, so that one
+ * unreachable server does not delay the others. Each account that finishes
+ * is immediately merged into ESourceList in the main loop. Accounts that
+ * don't finish in SYNC_ACCOUNT_TIMEOUT seconds are abandoned for this run
+ * and treated as temporarily not available. Accounts still waiting for a
+ * worker are abandoned SYNC_ACCOUNT_TIMEOUT seconds after the run started,
+ * because abandoned workers keep running and may occupy the whole pool.
+ */
+
+/* Serializes authentication of accounts synchronized in parallel, so that
+ * password prompts are not shown for several accounts at once. */
+G_LOCK_DEFINE_STATIC(sync_auth);
+
+/* contact server of one account */
+static void sync_account(EeeAccount *account)
+{
+    gboolean authenticated;
+
+    /* find server, if not account will still be checked for next time */
+    if (!eee_account_find_server(account))
+    {
+        eee_account_set_state(account, EEE_ACCOUNT_STATE_NOTAVAIL);
+        return;
+    }
+
+    /* connect to server, if not account will still be still checked for next time */
+    if (!eee_account_connect(account))
+    {
+        eee_account_set_state(account, EEE_ACCOUNT_STATE_NOTAVAIL);
+        return;
+    }
+
+    /* if authenticate fails, account will be automatically disabled for this session */
+    G_LOCK(sync_auth);
+    authenticated = eee_account_auth(account);
+    G_UNLOCK(sync_auth);
+
+    if (!authenticated)
+    {
+        eee_account_set_state(account, EEE_ACCOUNT_STATE_DISABLED);
+        eee_account_disconnect(account);
+        return;
+    }
+
+    eee_account_set_state(account, EEE_ACCOUNT_STATE_ONLINE);
+
+    /* load cals and say good bye */
+    eee_account_load_calendars(account, NULL);
+    eee_account_disconnect(account);
+}
+
+static struct sync_task *sync_task_new(EeeAccountsManager *mgr, EeeAccount *account, GAsyncQueue *results)
+{
+    struct sync_task *task = g_new0(struct sync_task, 1);
+
+    task->refs = 1;
+    task->mgr = mgr;
+    task->account = g_object_ref(account);
+    task->results = g_async_queue_ref(results);
+    task->state = SYNC_TASK_QUEUED;
+
+    return task;
+}
+
+static struct sync_task *sync_task_ref(struct sync_task *task)
+{
+    g_atomic_int_inc(&task->refs);
+    return task;
+}
+
+static void sync_task_unref(struct sync_task *task)
+{
+    if (g_atomic_int_dec_and_test(&task->refs))
+    {
+        g_object_unref(task->account);
+        g_async_queue_unref(task->results);
+        g_free(task);
+    }
+}
+
+/* sync worker pool function, result is passed back through task->results
+ * unless the task was abandoned meanwhile */
+static void sync_worker_func(struct sync_task *task, EeeAccountsManager *mgr)
+{
+    gboolean abandoned;
+
+    g_mutex_lock(mgr->priv->sync_lock);
+    abandoned = task->state == SYNC_TASK_ABANDONED;
+    if (!abandoned)
+    {
+        task->state = SYNC_TASK_RUNNING;
+        task->started = time(NULL);
+    }
+    g_mutex_unlock(mgr->priv->sync_lock);
+
+    if (!abandoned && g_atomic_int_get(&mgr->priv->sync_request) == SYNC_REQ_RUN)
+    {
+        sync_account(task->account);
+    }
+
+    g_mutex_lock(mgr->priv->sync_lock);
+    abandoned = task->state == SYNC_TASK_ABANDONED;
+    if (!abandoned)
+    {
+        task->state = SYNC_TASK_DONE;
+        g_async_queue_push(task->results, task);
+    }
+    g_mutex_unlock(mgr->priv->sync_lock);
+
+    if (abandoned)
+    {
+        sync_task_unref(task);
+    }
+}
+
+static gboolean sync_begin(gpointer data);
+static gboolean sync_apply_account(gpointer data);
+static gboolean sync_skip_account(gpointer data);
+
 static void eee_accounts_manager_sync_phase1(EeeAccountsManager *self)
 {
+    GAsyncQueue *results;
+    GSList *tasks = NULL;
     GSList *iter;
+    struct sync_task *task;
+    guint pending = 0;
+    time_t run_started;
 
     g_return_if_fail(IS_EEE_ACCOUNTS_MANAGER(self));
 
-    // go through the list of EeeAccount objects and load calendar lists
+    results = g_async_queue_new();
+    run_started = time(NULL);
+
+    run_idle(sync_begin, self);
+
+    // go through the list of EeeAccount objects and start loading calendar lists
     for (iter = self->priv->sync_accounts; iter; iter = iter->next)
     {
         EeeAccount *account = iter->data;
 
-        /* Reasons for aborting sync phase1 are:
-         * - evolution has gone offline
-         * - run is no longer requested
-         */
-        if (g_atomic_int_get(&self->priv->sync_request) != SYNC_REQ_RUN)
+        task = sync_task_new(self, account, results);
+        tasks = g_slist_prepend(tasks, task);
+
+        /* account is int he disabled_accounts list */
+        if (account->state != EEE_ACCOUNT_STATE_DISABLED &&
+            eee_accounts_manager_account_is_disabled(self, account->name))
         {
-            return;
+            eee_account_set_state(account, EEE_ACCOUNT_STATE_DISABLED);
         }
 
         /* account is already disabled for this session */
         if (account->state == EEE_ACCOUNT_STATE_DISABLED)
         {
+            task->state = SYNC_TASK_DONE;
+            run_idle(sync_apply_account, task);
             continue;
         }
 
-        /* account is int he disabled_accounts list */
-        if (eee_accounts_manager_account_is_disabled(self, account->name))
-        {
-            eee_account_set_state(account, EEE_ACCOUNT_STATE_DISABLED);
-            continue;
-        }
+        g_thread_pool_push(self->priv->sync_pool, sync_task_ref(task), NULL);
+        pending++;
+    }
 
-        /* find server, if not account will still be checked for next time */
-        if (!eee_account_find_server(account))
-        {
-            eee_account_set_state(account, EEE_ACCOUNT_STATE_NOTAVAIL);
-            continue;
-        }
+    while (pending > 0)
+    {
+        GTimeVal timeout;
+        time_t now;
 
+        /* Reasons for aborting sync phase1 are:
+         * - evolution has gone offline
+         * - run is no longer requested
+         */
         if (g_atomic_int_get(&self->priv->sync_request) != SYNC_REQ_RUN)
         {
-            return;
+            break;
         }
 
-        /* connect to server, if not account will still be still checked for next time */
-        if (!eee_account_connect(account))
+        g_get_current_time(&timeout);
+        g_time_val_add(&timeout, G_USEC_PER_SEC);
+        task = g_async_queue_timed_pop(results, &timeout);
+        if (task)
         {
-            eee_account_set_state(account, EEE_ACCOUNT_STATE_NOTAVAIL);
+            run_idle(sync_apply_account, task);
+            sync_task_unref(task);
+            pending--;
             continue;
         }
 
-        /* if authenticate fails, account will be automatically disabled for this session */
-        if (!eee_account_auth(account))
+        // give up accounts whose servers are stuck
+        now = time(NULL);
+        g_mutex_lock(self->priv->sync_lock);
+        for (iter = tasks; iter; iter = iter->next)
         {
-            eee_account_set_state(account, EEE_ACCOUNT_STATE_DISABLED);
-            eee_account_disconnect(account);
-            continue;
+            task = iter->data;
+            if ((task->state == SYNC_TASK_RUNNING && now - task->started > SYNC_ACCOUNT_TIMEOUT) ||
+                (task->state == SYNC_TASK_QUEUED && now - run_started > SYNC_ACCOUNT_TIMEOUT))
+            {
+                g_warning("** EEE ** Account '%s' timed out, skipping it for now.", task->account->name);
+                task->state = SYNC_TASK_ABANDONED;
+                pending--;
+                g_mutex_unlock(self->priv->sync_lock);
+                run_idle(sync_skip_account, task);
+                g_mutex_lock(self->priv->sync_lock);
+            }
         }
+        g_mutex_unlock(self->priv->sync_lock);
+    }
 
-        eee_account_set_state(account, EEE_ACCOUNT_STATE_ONLINE);
+    // sync was aborted, drop results of unfinished accounts
+    g_mutex_lock(self->priv->sync_lock);
+    for (iter = tasks; iter; iter = iter->next)
+    {
+        task = iter->data;
+        if (task->state != SYNC_TASK_DONE)
+        {
+            task->state = SYNC_TASK_ABANDONED;
+        }
+    }
+    g_mutex_unlock(self->priv->sync_lock);
 
-        /* load cals and say good bye */
-        eee_account_load_calendars(account, NULL);
-        eee_account_disconnect(account);
+    while ((task = g_async_queue_try_pop(results)))
+    {
+        sync_task_unref(task);
     }
+
+    g_slist_foreach(tasks, (GFunc)sync_task_unref, NULL);
+    g_slist_free(tasks);
+    g_async_queue_unref(results);
 }
 
 /* Find ESourceGroup in ESourceList
@@ -344,14 +538,12 @@ static ESourceGroup *find_group_in_list(ESourceList *eslist, const gchar* group_
     return NULL;
 }
 
-/* sync finish phase */
-static gboolean eee_accounts_manager_sync_phase2(EeeAccountsManager *self)
+/* unmark groups/sources before accounts are merged in */
+static gboolean sync_begin(gpointer data)
 {
-    GSList *iter, *iter2, *iter_next, *iter2_next;
-
-    g_return_val_if_fail(IS_EEE_ACCOUNTS_MANAGER(self), FALSE);
+    EeeAccountsManager *self = data;
+    GSList *iter, *iter2;
 
-    // unmark groups/sources
     for (iter = e_source_list_peek_groups(self->priv->eslist); iter; iter = iter->next)
     {
         ESourceGroup *group = E_SOURCE_GROUP(iter->data);
@@ -369,131 +561,171 @@ static gboolean eee_accounts_manager_sync_phase2(EeeAccountsManager *self)
         }
     }
 
-    // go through synced account description structures and update ESourceList
-    // accordingly
-    for (iter = self->priv->sync_accounts; iter; iter = iter->next)
-    {
-        EeeAccount *account = iter->data;
-        EeeAccount *current_account;
-        ESourceGroup *group;
-        char *group_name = g_strdup_printf("3e: %s", account->name);
+    return FALSE;
+}
 
-        // find ESourceGroup and EeeAccount
-        group = find_group_in_list(self->priv->eslist, group_name);
-//        group = e_source_list_peek_group_by_properties(self->priv->eslist, "name", group_name, NULL);
-        current_account = eee_accounts_manager_find_account_by_name(self, account->name);
+/* keep sources of account that is not available as they are */
+static void mark_account_sources(EeeAccountsManager *self, const char *name)
+{
+    GSList *iter_grp, *iter_src;
 
-        if (account->state == EEE_ACCOUNT_STATE_DISABLED)
+    for (iter_grp = e_source_list_peek_groups(self->priv->eslist); iter_grp; iter_grp = iter_grp->next)
+    {
+        ESourceGroup *group = iter_grp->data;
+        for (iter_src = e_source_group_peek_sources(group); iter_src; iter_src = iter_src->next)
         {
-            if (current_account)
+            ESource *source = iter_src->data;
+            const char *account_name = e_source_get_property(source, "eee-account");
+            if (account_name && !g_strcmp0(account_name, name))
             {
-                eee_accounts_manager_remove_account(self, current_account);
-            }
-            if (group)
-            {
-                e_source_list_remove_group(self->priv->eslist, group);
+                g_object_set_data(G_OBJECT(source), "synced", (gpointer)TRUE);
+                g_object_set_data(G_OBJECT(group), "synced", (gpointer)TRUE);
             }
-            g_object_unref(account);
-            continue;
         }
+    }
+}
 
-        // create account if it does not exist
-        if (current_account == NULL)
-        {
-            eee_accounts_manager_add_account(self, g_object_ref(account));
-        }
-        else
+/* abandoned account, runs in the main loop */
+static gboolean sync_skip_account(gpointer data)
+{
+    struct sync_task *task = data;
+    char *group_name = g_strdup_printf("3e: %s", task->account->name);
+    ESourceGroup *group = find_group_in_list(task->mgr->priv->eslist, group_name);
+
+    mark_account_sources(task->mgr, task->account->name);
+    if (group)
+    {
+        g_object_set_data(G_OBJECT(group), "synced", (gpointer)TRUE);
+    }
+    g_free(group_name);
+
+    return FALSE;
+}
+
+/* merge synced account into ESourceList, runs in the main loop */
+static gboolean sync_apply_account(gpointer data)
+{
+    struct sync_task *task = data;
+    EeeAccountsManager *self = task->mgr;
+    EeeAccount *account = task->account;
+    EeeAccount *current_account;
+    ESourceGroup *group;
+    char *group_name = g_strdup_printf("3e: %s", account->name);
+
+    // find ESourceGroup and EeeAccount
+    group = find_group_in_list(self->priv->eslist, group_name);
+    current_account = eee_accounts_manager_find_account_by_name(self, account->name);
+
+    if (account->state == EEE_ACCOUNT_STATE_DISABLED)
+    {
+        if (current_account)
         {
-            eee_account_copy(current_account, account);
+            eee_accounts_manager_remove_account(self, current_account);
         }
-
-        // create group if it does not exist
-        if (group == NULL)
+        if (group)
         {
-            group = e_source_group_new(group_name, EEE_URI_PREFIX);
-            e_source_list_add_group(self->priv->eslist, group, -1);
-            g_object_unref(group);
+            e_source_list_remove_group(self->priv->eslist, group);
+            e_source_list_sync(self->priv->eslist, NULL);
         }
         g_free(group_name);
+        return FALSE;
+    }
 
-        // check group sources if account is available, otherwise just mark them as
-        // synced
-        if (account->state == EEE_ACCOUNT_STATE_NOTAVAIL)
+    // create account if it does not exist
+    if (current_account == NULL)
+    {
+        eee_accounts_manager_add_account(self, g_object_ref(account));
+    }
+    else
+    {
+        eee_account_copy(current_account, account);
+    }
+
+    // create group if it does not exist
+    if (group == NULL)
+    {
+        group = e_source_group_new(group_name, EEE_URI_PREFIX);
+        e_source_list_add_group(self->priv->eslist, group, -1);
+        g_object_unref(group);
+    }
+    g_free(group_name);
+
+    // check group sources if account is available, otherwise just mark them as
+    // synced
+    if (account->state == EEE_ACCOUNT_STATE_NOTAVAIL)
+    {
+        mark_account_sources(self, account->name);
+    }
+    else
+    {
+        GArray * cals = eee_account_peek_calendars (account);
+        guint i;
+        for (i = 0; cals != NULL && i < cals->len; i++)
         {
-            GSList *iter_grp, *iter_src;
-            for (iter_grp = e_source_list_peek_groups(self->priv->eslist); iter_grp; iter_grp = iter_grp->next)
+            ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
+            ESource *source;
+
+            if (!g_strcmp0(cal->owner, account->name))
             {
-                ESourceGroup *group = iter_grp->data;
-                for (iter_src = e_source_group_peek_sources(group); iter_src; iter_src = iter_src->next)
+                // calendar owned by owner of account that represents current group
+                source = e_source_group_peek_source_by_calname(group, cal->name);
+                if (source == NULL)
+                {
+                    source = e_source_new_3e_with_attrs(cal->name, cal->owner, account, cal->perm, cal->attrs);
+                    e_source_group_add_source(group, source, -1);
+                    g_object_unref(source);
+                }
+                else
                 {
-                    ESource *source = iter_src->data;
-                    const char *account_name = e_source_get_property(source, "eee-account");
-                    if (account_name && !g_strcmp0(account_name, account->name))
-                    {
-                        g_object_set_data(G_OBJECT(source), "synced", (gpointer)TRUE);
-                        g_object_set_data(G_OBJECT(group), "synced", (gpointer)TRUE);
-                    }
+                    e_source_set_3e_properties_with_attrs(source, cal->name, cal->owner, account, cal->perm, cal->attrs);
                 }
             }
-        }
-        else
-        {
-            GArray * cals = eee_account_peek_calendars (account);
-            guint i;
-            for (i = 0; cals != NULL && i < cals->len; i++)
+            else
             {
-                ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
-                ESource *source;
+                char *owner_group_name = g_strdup_printf("3e: %s", cal->owner);
+                // shared calendar, it should be put into another group
+                ESourceGroup *owner_group = find_group_in_list(self->priv->eslist, owner_group_name);
+
+                if (owner_group == NULL)
+                {
+                    owner_group = e_source_group_new(owner_group_name, EEE_URI_PREFIX);
+                    e_source_list_add_group(self->priv->eslist, owner_group, -1);
+                    g_object_unref(owner_group);
+                }
+                g_object_set_data(G_OBJECT(owner_group), "synced", (gpointer)TRUE);
+                g_free(owner_group_name);
 
-                if (!g_strcmp0(cal->owner, account->name))
+                source = e_source_group_peek_source_by_calname(owner_group, cal->name);
+                if (source == NULL)
                 {
-                    // calendar owned by owner of account that represents current group
-                    source = e_source_group_peek_source_by_calname(group, cal->name);
-                    if (source == NULL)
-                    {
-                        source = e_source_new_3e_with_attrs(cal->name, cal->owner, account, cal->perm, cal->attrs);
-                        e_source_group_add_source(group, source, -1);
-                        g_object_unref(source);
-                    }
-                    else
-                    {
-                        e_source_set_3e_properties_with_attrs(source, cal->name, cal->owner, account, cal->perm, cal->attrs);
-                    }
+                    source = e_source_new_3e_with_attrs(cal->name, cal->owner, account, cal->perm, cal->attrs);
+                    e_source_group_add_source(owner_group, source, -1);
+                    g_object_unref(source);
                 }
                 else
                 {
-                    char *owner_group_name = g_strdup_printf("3e: %s", cal->owner);
-                    // shared calendar, it should be put into another group
-                    ESourceGroup *owner_group = find_group_in_list(self->priv->eslist, owner_group_name);
-
-                    if (owner_group == NULL)
-                    {
-                        owner_group = e_source_group_new(owner_group_name, EEE_URI_PREFIX);
-                        e_source_list_add_group(self->priv->eslist, owner_group, -1);
-                        g_object_unref(owner_group);
-                    }
-                    g_object_set_data(G_OBJECT(owner_group), "synced", (gpointer)TRUE);
-
-                    source = e_source_group_peek_source_by_calname(owner_group, cal->name);
-                    if (source == NULL)
-                    {
-                        source = e_source_new_3e_with_attrs(cal->name, cal->owner, account, cal->perm, cal->attrs);
-                        e_source_group_add_source(owner_group, source, -1);
-                        g_object_unref(source);
-                    }
-                    else
-                    {
-                        e_source_set_3e_properties_with_attrs(source, cal->name, cal->owner, account, cal->perm, cal->attrs);
-                    }
+                    e_source_set_3e_properties_with_attrs(source, cal->name, cal->owner, account, cal->perm, cal->attrs);
                 }
-                g_object_set_data(G_OBJECT(source), "synced", (gpointer)TRUE);
             }
+            g_object_set_data(G_OBJECT(source), "synced", (gpointer)TRUE);
         }
-
-        g_object_set_data(G_OBJECT(group), "synced", (gpointer)TRUE);
-        g_object_unref(account);
     }
 
+    g_object_set_data(G_OBJECT(group), "synced", (gpointer)TRUE);
+
+    e_source_list_sync(self->priv->eslist, NULL);
+
+    return FALSE;
+}
+
+/* sync finish phase, all accounts are merged in, remove what's left over */
+static gboolean eee_accounts_manager_sync_phase2(EeeAccountsManager *self)
+{
+    GSList *iter, *iter2, *iter_next, *iter2_next;
+
+    g_return_val_if_fail(IS_EEE_ACCOUNTS_MANAGER(self), FALSE);
+
+    g_slist_foreach(self->priv->sync_accounts, (GFunc)g_object_unref, NULL);
     g_slist_free(self->priv->sync_accounts);
     self->priv->sync_accounts = NULL;
 
@@ -588,13 +820,50 @@ void eee_accounts_manager_remove_account(EeeAccountsManager *self, EeeAccount *a
     }
 }
 
+/* reload disabled accounts set from gconf */
+static void load_disabled_accounts(EeeAccountsManager *self)
+{
+    GSList *accounts;
+    GSList *iter;
+
+    accounts = gconf_client_get_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, NULL);
+
+    g_mutex_lock(self->priv->disabled_lock);
+    g_hash_table_remove_all(self->priv->disabled_accounts);
+    for (iter = accounts; iter; iter = iter->next)
+    {
+        // hash table takes the string
+        g_hash_table_replace(self->priv->disabled_accounts, iter->data, GINT_TO_POINTER(TRUE));
+    }
+    g_mutex_unlock(self->priv->disabled_lock);
+
+    g_slist_free(accounts);
+}
+
+/* callback called when disabled_accounts gconf key changes */
+static void disabled_accounts_changed(GConfClient *client, guint cnxn_id, GConfEntry *entry, EeeAccountsManager *mgr)
+{
+    load_disabled_accounts(mgr);
+}
+
+/* store disabled accounts set to gconf */
+static void save_disabled_accounts(EeeAccountsManager *self)
+{
+    GSList *accounts;
+
+    g_mutex_lock(self->priv->disabled_lock);
+    accounts = g_hash_table_get_keys(self->priv->disabled_accounts);
+    gconf_client_set_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, accounts, NULL);
+    g_mutex_unlock(self->priv->disabled_lock);
+
+    g_slist_free(accounts);
+}
+
 /* these method are useful to manipulate disabled accounts list, these are
  * account names that plugin should not try to access or show in any way, user
  * can disable/enable account only manually using evo. account preferences */
 void eee_accounts_manager_disable_account(EeeAccountsManager *self, const char *name)
 {
-    GSList *accounts;
-
     g_return_if_fail(IS_EEE_ACCOUNTS_MANAGER(self));
     g_return_if_fail(name != NULL);
 
@@ -603,55 +872,40 @@ void eee_accounts_manager_disable_account(EeeAccountsManager *self, const char *
         return;
     }
 
-    accounts = gconf_client_get_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, NULL);
-
-    accounts = g_slist_append(accounts, g_strdup(name));
+    g_mutex_lock(self->priv->disabled_lock);
+    g_hash_table_replace(self->priv->disabled_accounts, g_strdup(name), GINT_TO_POINTER(TRUE));
+    g_mutex_unlock(self->priv->disabled_lock);
 
-    gconf_client_set_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, accounts, NULL);
-    g_slist_foreach(accounts, (GFunc)g_free, NULL);
-    g_slist_free(accounts);
+    save_disabled_accounts(self);
 }
 
 void eee_accounts_manager_enable_account(EeeAccountsManager *self, const char *name)
 {
-    GSList *accounts;
-    GSList *item;
+    gboolean removed;
 
     g_return_if_fail(IS_EEE_ACCOUNTS_MANAGER(self));
     g_return_if_fail(name != NULL);
 
-    accounts = gconf_client_get_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, NULL);
+    g_mutex_lock(self->priv->disabled_lock);
+    removed = g_hash_table_remove(self->priv->disabled_accounts, name);
+    g_mutex_unlock(self->priv->disabled_lock);
 
-    while (TRUE)
+    if (removed)
     {
-        item = g_slist_find_custom(accounts, name, (GCompareFunc)g_strcmp0);
-        if (item == NULL)
-        {
-            break;
-        }
-        g_free(item->data);
-        accounts = g_slist_remove_link(accounts, item);
+        save_disabled_accounts(self);
     }
-
-    gconf_client_set_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, accounts, NULL);
-    g_slist_foreach(accounts, (GFunc)g_free, NULL);
-    g_slist_free(accounts);
 }
 
 gboolean eee_accounts_manager_account_is_disabled(EeeAccountsManager *self, const char *name)
 {
-    GSList *accounts;
     gboolean disabled;
 
     g_return_val_if_fail(IS_EEE_ACCOUNTS_MANAGER(self), FALSE);
     g_return_val_if_fail(name != NULL, FALSE);
 
-    accounts = gconf_client_get_list(self->priv->gconf, EEE_KEY "disabled_accounts", GCONF_VALUE_STRING, NULL);
-
-    disabled = !!g_slist_find_custom(accounts, name, (GCompareFunc)g_strcmp0);
-
-    g_slist_foreach(accounts, (GFunc)g_free, NULL);
-    g_slist_free(accounts);
+    g_mutex_lock(self->priv->disabled_lock);
+    disabled = g_hash_table_lookup(self->priv->disabled_accounts, name) != NULL;
+    g_mutex_unlock(self->priv->disabled_lock);
 
     return disabled;
 }
@@ -713,11 +967,14 @@ EeeAccount *eee_accounts_manager_find_account_by_source(EeeAccountsManager *self
 void eee_accounts_manager_load_access_accounts_list(EeeAccountsManager *self)
 {
     EIterator *iter;
+    GHashTable *seen;
 
     g_slist_foreach(self->priv->access_accounts, (GFunc)g_free, NULL);
     g_slist_free(self->priv->access_accounts);
     self->priv->access_accounts = NULL;
 
+    seen = g_hash_table_new(g_str_hash, g_str_equal);
+
     for (iter = e_list_get_iterator(E_LIST(self->priv->ealist));
          e_iterator_is_valid(iter);
          e_iterator_next(iter))
@@ -732,12 +989,17 @@ void eee_accounts_manager_load_access_accounts_list(EeeAccountsManager *self)
         {
             continue;
         }
-        if (g_slist_find_custom(self->priv->access_accounts, (gpointer)name, (GCompareFunc)g_strcmp0))
+        if (g_hash_table_lookup(seen, name))
         {
             continue;
         }
-        self->priv->access_accounts = g_slist_append(self->priv->access_accounts, g_strdup(name));
+        name = g_strdup(name);
+        g_hash_table_insert(seen, (gpointer)name, (gpointer)name);
+        self->priv->access_accounts = g_slist_prepend(self->priv->access_accounts, (gpointer)name);
     }
+
+    self->priv->access_accounts = g_slist_reverse(self->priv->access_accounts);
+    g_hash_table_destroy(seen);
 }
 
 /* callback called when EAccountList changes */
@@ -866,6 +1128,13 @@ static void eee_accounts_manager_init(EeeAccountsManager *self)
     self->priv->ealist = e_account_list_new(self->priv->gconf);
     self->priv->eslist = e_source_list_new_for_gconf(self->priv->gconf, CALENDAR_SOURCES);
 
+    self->priv->disabled_accounts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    self->priv->disabled_lock = g_mutex_new();
+    load_disabled_accounts(self);
+    gconf_client_add_dir(self->priv->gconf, EEE_DIR, GCONF_CLIENT_PRELOAD_NONE, NULL);
+    self->priv->disabled_notify = gconf_client_notify_add(self->priv->gconf, EEE_KEY "disabled_accounts",
+                                                          (GConfClientNotifyFunc)disabled_accounts_changed, self, NULL, NULL);
+
     eee_accounts_manager_load_access_accounts_list(self);
     eee_accounts_manager_activate_accounts(self);
 
@@ -882,6 +1151,8 @@ static void eee_accounts_manager_init(EeeAccountsManager *self)
         self->priv->sync_request = SYNC_REQ_START;
     }
 
+    self->priv->sync_lock = g_mutex_new();
+    self->priv->sync_pool = g_thread_pool_new((GFunc)sync_worker_func, self, SYNC_WORKERS, FALSE, NULL);
     self->priv->sync_thread = g_thread_create(sync_thread_func, self, FALSE, NULL);
 }
 
@@ -898,11 +1169,17 @@ static void eee_accounts_manager_finalize(GObject *object)
 
     g_slist_foreach(self->priv->accounts, (GFunc)g_object_unref, NULL);
     g_slist_free(self->priv->accounts);
+    gconf_client_notify_remove(self->priv->gconf, self->priv->disabled_notify);
+    gconf_client_remove_dir(self->priv->gconf, EEE_DIR, NULL);
     g_object_unref(self->priv->gconf);
     g_object_unref(self->priv->eslist);
     g_object_unref(self->priv->ealist);
     g_atomic_int_set(&self->priv->sync_request, SYNC_REQ_STOP);
     g_thread_join(self->priv->sync_thread);
+    g_thread_pool_free(self->priv->sync_pool, FALSE, TRUE);
+    g_mutex_free(self->priv->sync_lock);
+    g_hash_table_destroy(self->priv->disabled_accounts);
+    g_mutex_free(self->priv->disabled_lock);
 
     G_OBJECT_CLASS(eee_accounts_manager_parent_class)->finalize(object);
 }
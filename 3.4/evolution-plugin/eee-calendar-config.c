@@ -362,7 +362,7 @@ void eee_calendar_properties_commit(EPlugin *epl, ECalConfigTargetSource *target
         {
             eee_account_update_calendar_settings(account, account->name, calname, e_source_peek_name(source), converted_color);
         }
-        eee_account_disconnect(account);
+        eee_account_release(account);
 
         e_source_set_3e_properties(source, calname, account->name, account, "write", NULL, 0); // title and color are already set
         eee_accounts_manager_add_source(mgr(), account->name, g_object_ref(source));
@@ -379,7 +379,7 @@ void eee_calendar_properties_commit(EPlugin *epl, ECalConfigTargetSource *target
         const char *calname = e_source_get_property(source, "eee-calname");
         const char *owner = e_source_get_property(source, "eee-owner");
         eee_account_update_calendar_settings(account, owner, calname, e_source_peek_name(source), converted_color);
-        eee_account_disconnect(account);
+        eee_account_release(account);
 
         struct acl_context * ctx = g_object_get_data (G_OBJECT (target->source), "eee-acl-context");
         store_acl (ctx);
@@ -477,7 +477,7 @@ static void on_unsubscribe_cb(GtkAction *action, EShellView *shell_view)
 
         e_source_group_remove_source(group, source);
     }
-    eee_account_disconnect(account);
+    eee_account_release(account);
     eee_accounts_manager_restart_sync(mgr());
 }
 
@@ -530,7 +530,7 @@ static void on_delete_cb(GtkAction *action, EShellView *shell_view)
 
         e_source_group_remove_source(group, source);
     }
-    eee_account_disconnect(account);
+    eee_account_release(account);
     eee_accounts_manager_restart_sync(mgr());
 }
 
@@ -972,38 +972,94 @@ GtkWidget* eee_account_wizard_page(EPlugin *epl, EConfigHookItemFactoryData *dat
     return page;
 }
 
-gboolean eee_account_wizard_check(EPlugin *epl, EConfigHookPageCheckData *data)
+/* server lookup for e-mail entered in the wizard, runs in background */
+struct wizard_lookup
 {
-    const char *name = ((EMConfigTargetSettings *) data->config->target)->email_address;
-    char *eee_host = NULL;
-    GtkWidget *page;
+    char *name;
+    char *host;
+};
 
-    g_return_val_if_fail (lbl != NULL, FALSE);
+static EeeAccount *wizard_account = NULL; // only used to run lookups
+static GCancellable *wizard_cancellable = NULL;
+static char *wizard_name = NULL; // e-mail of last started lookup
+static gboolean wizard_lookup_pending = FALSE;
 
-    if (name == NULL)
-        return TRUE;
+static void wizard_lookup_free(struct wizard_lookup *lookup)
+{
+    g_free(lookup->name);
+    g_free(lookup->host);
+    g_free(lookup);
+}
 
-    g_debug("** EEE **: Wizard check: E-mail: %s", name);
+static void wizard_lookup_func(EeeAccount *account, struct wizard_lookup *lookup, GCancellable *cancellable)
+{
+    lookup->host = get_eee_server_hostname(lookup->name);
+}
 
-    if (name != NULL)
-        eee_host = get_eee_server_hostname(name);
+static void wizard_lookup_finish(const char *name, const char *eee_host)
+{
+    wizard_lookup_pending = FALSE;
 
     if (eee_host != NULL)
     {
         dns_resolv_successful = TRUE;
 /*        gtk_assistant_set_forward_page_func(assistant, NULL, NULL, NULL);*/
-        gtk_label_set_text(lbl, g_strdup_printf(_("3e calendar server has been found for your domain. You can enable\n"
-                                                  "calendar account for your account <i>%s</i> if you have it. If you\n"
-                                                  "don't know ask your system administrator or provider of your email\n"
-                                                  "service. Go to email account preferences to change this setting later."), name));
+        char *text = g_strdup_printf(_("3e calendar server has been found for your domain. You can enable\n"
+                                       "calendar account for your account <i>%s</i> if you have it. If you\n"
+                                       "don't know ask your system administrator or provider of your email\n"
+                                       "service. Go to email account preferences to change this setting later."), name);
+        gtk_label_set_text(lbl, text);
         gtk_label_set_use_markup(lbl, TRUE);
-//        g_free (eee_host);
+        g_free(text);
     }
     else
     {
         dns_resolv_successful = FALSE;
 /*        gtk_assistant_set_forward_page_func(assistant, skip_3e_page, NULL, NULL);*/
     }
+}
+
+static void wizard_lookup_done(EeeAccount *account, struct wizard_lookup *lookup)
+{
+    wizard_lookup_finish(lookup->name, lookup->host);
+}
+
+gboolean eee_account_wizard_check(EPlugin *epl, EConfigHookPageCheckData *data)
+{
+    const char *name = ((EMConfigTargetSettings *) data->config->target)->email_address;
+    struct wizard_lookup *lookup;
+
+    g_return_val_if_fail (lbl != NULL, FALSE);
+
+    if (name == NULL)
+        return TRUE;
+
+    // lookup for this e-mail is already running or done
+    if (!g_strcmp0(name, wizard_name))
+        return TRUE;
+
+    g_debug("** EEE **: Wizard check: E-mail: %s", name);
+
+    // DNS lookup may take a while, don't block the wizard while user types
+    if (wizard_cancellable)
+    {
+        g_cancellable_cancel(wizard_cancellable);
+        g_object_unref(wizard_cancellable);
+    }
+    wizard_cancellable = g_cancellable_new();
+
+    if (wizard_account == NULL)
+        wizard_account = eee_account_new("wizard");
+
+    g_free(wizard_name);
+    wizard_name = g_strdup(name);
+    dns_resolv_successful = FALSE;
+    wizard_lookup_pending = TRUE;
+
+    lookup = g_new0(struct wizard_lookup, 1);
+    lookup->name = g_strdup(name);
+    eee_account_run_async(wizard_account, (EeeAccountAsyncFunc)wizard_lookup_func, (EeeAccountAsyncDone)wizard_lookup_done,
+                          lookup, (GDestroyNotify)wizard_lookup_free, wizard_cancellable);
 
     return TRUE;
 }
@@ -1012,6 +1068,19 @@ void eee_account_wizard_commit(EPlugin *epl, EMConfigTargetSettings *target)
 {
     const char *name = target->email_address;
 
+    // user got here before background lookup finished
+    if (wizard_lookup_pending || g_strcmp0(name, wizard_name))
+    {
+        char *eee_host = get_eee_server_hostname(name);
+
+        if (wizard_cancellable)
+            g_cancellable_cancel(wizard_cancellable);
+        g_free(wizard_name);
+        wizard_name = g_strdup(name);
+        wizard_lookup_finish(name, eee_host);
+        g_free(eee_host);
+    }
+
     if ((wizard_eee_account_activated == TRUE) && (dns_resolv_successful == TRUE)) 
         eee_accounts_manager_enable_account(mgr(), name);
     else
@@ -44,122 +44,208 @@ enum
     SUB_NUM_COLUMNS
 };
 
+/* Number of calendars fetched from server at once. */
+#define SEARCH_PAGE_SIZE 50
+
+/* Next page is loaded when the list is scrolled this close to its end
+ * (in pixels). */
+#define SEARCH_LOAD_MARGIN 100
+
 struct subscribe_context
 {
     GtkBuilder *builder;
     GtkWindow *win;
     GtkTreeStore *model;
     GtkTreeView *tview;
+    GtkAdjustment *vadjustment; // of the scrolled window with tview
     GtkWidget *subscribe_button;
     GtkTreeSelection *selection;
     GtkEditable *search;
     EeeAccountsManager *mgr;
     EeeAccount *account; // no-ref, reference is held by model
+    GHashTable *subscribed; // "owner:name" of calendars user already has
+    gboolean subscribed_loaded; // subscribed is filled for current account
+    GHashTable *owners; // owner -> GtkTreeIter of owner row
+    char *query; // prefix being searched for
+    guint offset; // number of calendars fetched for query
+    gboolean loading; // page request for query is running
+    gboolean has_more; // server may have more calendars matching query
+    GCancellable *cancellable; // cancels loading of results for stale query
+};
+
+/* one page of search results loaded in background */
+struct page_request
+{
+    struct subscribe_context *ctx;
+    char *query;
+    guint offset;
+    gboolean load_subscribed; // also load calendars user already has
+    gboolean ok;
+    GSList *subscribed; // "owner:name" of calendars user already has
+    GArray *cals;
+    GHashTable *realnames; // owner -> realname
 };
 
 static struct subscribe_context *active_ctx = NULL;
 
-static gboolean calendar_exists(GArray *cals, ESCalendarInfo *ref_cal)
+static char *calendar_key(ESCalendarInfo *cal)
 {
-    guint i;
+    return g_strdup_printf("%s:%s", cal->owner, cal->name);
+}
 
-    for (i = 0; i < cals->len; i++)
+static void page_request_free(struct page_request *req)
+{
+    g_slist_foreach(req->subscribed, (GFunc)g_free, NULL);
+    g_slist_free(req->subscribed);
+    if (req->cals)
     {
-        ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
-
-        if (!g_strcmp0(cal->name, ref_cal->name) &&
-            !g_strcmp0(cal->owner, ref_cal->owner))
-        {
-            return TRUE;
-        }
+        eee_account_free_calendars_list(req->cals);
     }
-
-    return FALSE;
+    g_hash_table_destroy(req->realnames);
+    g_free(req->query);
+    g_free(req);
 }
 
-static gboolean reload_data(struct subscribe_context *ctx, const char *query)
+/* Fetch page of search results, runs in account's async thread. */
+static void load_page_func(EeeAccount *account, struct page_request *req, GCancellable *cancellable)
 {
-    GArray *cals, *existing_cals;
+    GSList *owners = NULL;
     guint i;
-    GtkTreeIter titer_user;
-    GtkTreeIter titer_cal;
-    gchar *dquery = NULL;
 
-    gtk_tree_store_clear(ctx->model);
+    if (req->load_subscribed)
+    {
+        GArray *existing_cals;
+
+        if (!eee_account_load_calendars(account, &existing_cals))
+        {
+            eee_account_disconnect(account);
+            return;
+        }
+
+        for (i = 0; i < existing_cals->len; i++)
+        {
+            ESCalendarInfo *cal = g_array_index (existing_cals, ESCalendarInfo *, i);
+            req->subscribed = g_slist_prepend(req->subscribed, calendar_key(cal));
+        }
+        eee_account_free_calendars_list(existing_cals);
+    }
 
-    if (!eee_account_search_shared_calendars(ctx->account, "", &cals) ||
-        !eee_account_load_calendars(ctx->account, &existing_cals))
+    if (g_cancellable_is_cancelled(cancellable))
     {
-        eee_account_disconnect(ctx->account);
-        return FALSE;
+        return;
     }
 
-    if (query && *query != '\n')
-        dquery = g_ascii_strdown (query, -1);
+    if (!eee_account_search_shared_calendars_page(account, req->query, req->offset, SEARCH_PAGE_SIZE, &req->cals))
+    {
+        eee_account_disconnect(account);
+        return;
+    }
 
-    // for each user get his calendars
-    char *prev_owner = NULL;
-    for (i = 0; i < cals->len; i++)
+    // get realnames of all owners on this page at once
+    for (i = 0; i < req->cals->len; i++)
     {
-        const char *cal_title = NULL;
-        ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
+        ESCalendarInfo *cal = g_array_index (req->cals, ESCalendarInfo *, i);
+        owners = g_slist_prepend(owners, cal->owner);
+    }
+    eee_account_prefetch_realnames(account, owners);
+    g_slist_free(owners);
 
-        // skip already subscribed cals
-        if (calendar_exists(existing_cals, cal))
+    for (i = 0; i < req->cals->len; i++)
+    {
+        ESCalendarInfo *cal = g_array_index (req->cals, ESCalendarInfo *, i);
+        const char *realname = eee_account_peek_realname(account, cal->owner);
+
+        if (realname)
         {
-            continue;
+            g_hash_table_replace(req->realnames, g_strdup(cal->owner), g_strdup(realname));
         }
+    }
 
-        cal_title = eee_find_attribute_value(cal->attrs, "title");
+    req->ok = TRUE;
+}
 
-        if (dquery)
-        {
-            gboolean cont;
-            gchar *downer, *dtitle, *dname;
+static void load_page(struct subscribe_context *ctx, gboolean load_subscribed);
+static void load_more_if_needed(struct subscribe_context *ctx);
 
-            downer = g_ascii_strdown (cal->owner, -1);
-            dtitle = g_ascii_strdown (cal_title, -1);
-            dname = g_ascii_strdown (cal->name, -1);
+static GtkTreeIter *get_owner_row(struct subscribe_context *ctx, struct page_request *req, const char *owner)
+{
+    GtkTreeIter *titer_user = g_hash_table_lookup(ctx->owners, owner);
+    const char *realname;
+    char *title;
+
+    if (titer_user)
+    {
+        return titer_user;
+    }
+
+    realname = g_hash_table_lookup(req->realnames, owner);
+    if (realname)
+        title = g_strdup_printf("%s <%s>", realname, owner);
+    else
+        title = g_strdup_printf("%s", owner);
+
+    titer_user = g_new0(GtkTreeIter, 1);
+    gtk_tree_store_append(ctx->model, titer_user, NULL);
+    gtk_tree_store_set(ctx->model, titer_user,
+                       SUB_NAME_COLUMN, owner,
+                       SUB_TITLE_COLUMN, title,
+                       SUB_PERM_COLUMN, "",
+                       SUB_OWNER_COLUMN, owner,
+                       SUB_IS_CALENDAR_COLUMN, FALSE, -1);
+    g_hash_table_insert(ctx->owners, g_strdup(owner), titer_user);
+
+    g_free(title);
+
+    return titer_user;
+}
+
+/* Show page of search results, next one is loaded only when user scrolls
+ * down to it. Not called for pages of stale queries. */
+static void load_page_done(EeeAccount *account, struct page_request *req)
+{
+    struct subscribe_context *ctx = req->ctx;
+    GSList *iter;
+    guint i;
 
-            cont = !g_str_has_prefix (downer, dquery) &&
-                   !g_str_has_prefix (dtitle, dquery) &&
-                   !g_str_has_prefix (dname, dquery);
+    ctx->loading = FALSE;
 
-            g_free (downer);
-            g_free (dtitle);
-            g_free (dname);
+    if (!req->ok)
+    {
+        ctx->has_more = FALSE;
+        return;
+    }
 
-            if (cont)
-                continue;
+    if (req->load_subscribed)
+    {
+        g_hash_table_remove_all(ctx->subscribed);
+        for (iter = req->subscribed; iter; iter = iter->next)
+        {
+            g_hash_table_insert(ctx->subscribed, g_strdup(iter->data), GINT_TO_POINTER(TRUE));
         }
+        ctx->subscribed_loaded = TRUE;
+    }
 
-        if (!prev_owner || g_strcmp0(prev_owner, cal->owner))
+    for (i = 0; i < req->cals->len; i++)
+    {
+        const char *cal_title = NULL;
+        ESCalendarInfo *cal = g_array_index (req->cals, ESCalendarInfo *, i);
+        GtkTreeIter *titer_user;
+        GtkTreeIter titer_cal;
+        char *key = calendar_key(cal);
+        gboolean exists = g_hash_table_lookup(ctx->subscribed, key) != NULL;
+
+        g_free(key);
+
+        // skip already subscribed cals
+        if (exists)
         {
-            GArray *attrs = NULL;
-            const char *realname = NULL;
-            char *title;
-
-            eee_account_get_user_attributes(ctx->account, cal->owner, &attrs);
-            realname = eee_find_attribute_value(attrs, "realname");
-            if (realname)
-                title = g_strdup_printf("%s <%s>", realname, cal->owner);
-            else
-                title = g_strdup_printf("%s", cal->owner);
-
-            gtk_tree_store_append(ctx->model, &titer_user, NULL);
-            gtk_tree_store_set(ctx->model, &titer_user,
-                               SUB_NAME_COLUMN, cal->owner,
-                               SUB_TITLE_COLUMN, title,
-                               SUB_PERM_COLUMN, "",
-                               SUB_OWNER_COLUMN, cal->owner,
-                               SUB_IS_CALENDAR_COLUMN, FALSE, -1);
-            prev_owner = cal->owner;
-
-            g_free(title);
-            eee_account_free_attributes_list(attrs);
+            continue;
         }
 
-        gtk_tree_store_append(ctx->model, &titer_cal, &titer_user);
+        cal_title = eee_find_attribute_value(cal->attrs, "title");
+        titer_user = get_owner_row(ctx, req, cal->owner);
+
+        gtk_tree_store_append(ctx->model, &titer_cal, titer_user);
         gtk_tree_store_set(ctx->model, &titer_cal,
                            SUB_NAME_COLUMN, cal->name,
                            SUB_TITLE_COLUMN, cal_title ? cal_title : cal->name,
@@ -168,14 +254,84 @@ static gboolean reload_data(struct subscribe_context *ctx, const char *query)
                            SUB_IS_CALENDAR_COLUMN, TRUE, -1);
     }
 
-    if (dquery)
-        g_free (dquery);
-
-    eee_account_disconnect(ctx->account);
-    eee_account_free_calendars_list(cals);
+    ctx->offset += req->cals->len;
 
     gtk_tree_view_expand_all(ctx->tview);
 
+    ctx->has_more = req->cals->len == SEARCH_PAGE_SIZE;
+    // whole page may have been skipped or list may not fill the window yet
+    load_more_if_needed(ctx);
+}
+
+/* Ask for next page of search results in background. */
+static void load_page(struct subscribe_context *ctx, gboolean load_subscribed)
+{
+    struct page_request *req = g_new0(struct page_request, 1);
+
+    req->ctx = ctx;
+    req->query = g_strdup(ctx->query);
+    req->offset = ctx->offset;
+    req->load_subscribed = load_subscribed;
+    req->realnames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    ctx->loading = TRUE;
+    eee_account_run_async(ctx->account, (EeeAccountAsyncFunc)load_page_func, (EeeAccountAsyncDone)load_page_done,
+                          req, (GDestroyNotify)page_request_free, ctx->cancellable);
+}
+
+/* Load next page of search results if the list is scrolled near its end. */
+static void load_more_if_needed(struct subscribe_context *ctx)
+{
+    gdouble value = gtk_adjustment_get_value(ctx->vadjustment);
+    gdouble page_size = gtk_adjustment_get_page_size(ctx->vadjustment);
+    gdouble upper = gtk_adjustment_get_upper(ctx->vadjustment);
+
+    if (!ctx->has_more || ctx->loading || ctx->account == NULL)
+    {
+        return;
+    }
+
+    if (value + page_size + SEARCH_LOAD_MARGIN >= upper)
+    {
+        load_page(ctx, FALSE);
+    }
+}
+
+static void calendars_scrolled(GtkAdjustment *adjustment, struct subscribe_context *ctx)
+{
+    load_more_if_needed(ctx);
+}
+
+/* Drop results of requests that are still running. */
+static void stop_loading(struct subscribe_context *ctx)
+{
+    ctx->loading = FALSE;
+    ctx->has_more = FALSE;
+
+    if (ctx->cancellable)
+    {
+        g_cancellable_cancel(ctx->cancellable);
+        g_object_unref(ctx->cancellable);
+        ctx->cancellable = NULL;
+    }
+}
+
+/* Show calendars matching query, further pages are loaded as user scrolls
+ * down. Calendars user already has are loaded with the first page until some
+ * request gets them, requests cancelled by typing don't. */
+static gboolean reload_data(struct subscribe_context *ctx, const char *query)
+{
+    stop_loading(ctx);
+    gtk_tree_store_clear(ctx->model);
+    g_hash_table_remove_all(ctx->owners);
+
+    g_free(ctx->query);
+    ctx->query = g_strdup(query ? query : "");
+    ctx->offset = 0;
+
+    ctx->cancellable = g_cancellable_new();
+    load_page(ctx, !ctx->subscribed_loaded);
+
     return TRUE;
 }
 
@@ -184,11 +340,15 @@ static void account_selected(GtkComboBox *combo, struct subscribe_context *ctx)
     GtkTreeIter iter;
     EeeAccount *account = NULL;
 
+    stop_loading(ctx);
     ctx->account = NULL;
     if (gtk_combo_box_get_active_iter(combo, &iter))
     {
         gtk_tree_model_get(gtk_combo_box_get_model(combo), &iter, 1, &account, -1);
         gtk_tree_store_clear(ctx->model);
+        g_hash_table_remove_all(ctx->owners);
+        g_hash_table_remove_all(ctx->subscribed);
+        ctx->subscribed_loaded = FALSE;
         if (account)
         {
             ctx->account = account;
@@ -203,7 +363,7 @@ static void search_entry_changed(GtkEditable *editable, struct subscribe_context
 {
     char *text = gtk_editable_get_chars(editable, 0, -1);
 
-    if (text)
+    if (text && ctx->account)
     {
         reload_data(ctx, text);
     }
@@ -279,6 +439,8 @@ static void on_subs_button_subscribe_clicked(GtkButton *button, struct subscribe
 
     if (!eee_account_subscribe_calendar(ctx->account, owner, name))
     {
+        // don't keep connection that may be broken for later reuse
+        eee_account_disconnect(ctx->account);
         goto err1;
     }
 
@@ -292,9 +454,9 @@ static void on_subs_button_subscribe_clicked(GtkButton *button, struct subscribe
 
     eee_accounts_manager_add_source(ctx->mgr, owner, source);
     eee_accounts_manager_restart_sync(ctx->mgr);
+    eee_account_release(ctx->account);
 
 err1:
-    eee_account_disconnect(ctx->account);
     g_free(color_string);
     g_free(name);
     g_free(title);
@@ -315,6 +477,12 @@ static void on_subs_window_destroy(GtkWidget *object, struct subscribe_context *
 static void on_subs_window_destroy(GtkObject *object, struct subscribe_context *ctx)
 #endif /* !EDS_CHECK_VERSION(3,0,0) */
 {
+    stop_loading(ctx);
+    g_signal_handlers_disconnect_by_func(ctx->vadjustment, calendars_scrolled, ctx);
+    g_object_unref(ctx->vadjustment);
+    g_hash_table_destroy(ctx->subscribed);
+    g_hash_table_destroy(ctx->owners);
+    g_free(ctx->query);
     g_object_unref(ctx->win);
     g_object_unref(ctx->tview);
     g_object_unref(ctx->search);
@@ -357,6 +525,8 @@ void subscribe_gui_create(EeeAccountsManager *mgr)
 
     struct subscribe_context *c = g_new0(struct subscribe_context, 1);
     c->mgr = mgr;
+    c->subscribed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    c->owners = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     c->builder = gtk_builder_new ();
     gtk_builder_add_from_file (c->builder, PLUGINDIR "/org-gnome-evolution-eee.glade", NULL);
 
@@ -377,6 +547,12 @@ void subscribe_gui_create(EeeAccountsManager *mgr)
     c->selection = gtk_tree_view_get_selection(c->tview);
     gtk_tree_selection_set_mode(c->selection, GTK_SELECTION_SINGLE);
     g_signal_connect(c->selection, "changed", G_CALLBACK(calendar_selection_changed), c);
+    // load further pages of search results on demand, "changed" is emitted
+    // when the list grows and may still fit the window
+    c->vadjustment = GTK_ADJUSTMENT(g_object_ref(gtk_scrolled_window_get_vadjustment(
+        GTK_SCROLLED_WINDOW(gtk_builder_get_object(c->builder, "scrolledwindow")))));
+    g_signal_connect(c->vadjustment, "value-changed", G_CALLBACK(calendars_scrolled), c);
+    g_signal_connect(c->vadjustment, "changed", G_CALLBACK(calendars_scrolled), c);
 
     // setup account list combo box
     GSList *iter, *list;
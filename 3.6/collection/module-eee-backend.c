@@ -34,11 +34,17 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_EEE_BACKEND, EEeeBackendPrivate))
 
+/* server refuses getCalendarsPermissions with more calendars than this */
+#define CALENDARS_PERMISSIONS_MAX 1000
+
 typedef struct _EEeeBackendPrivate EEeeBackendPrivate;
 
 struct _EEeeBackendPrivate {
 	gchar *password;
 	gboolean need_update_calendars;
+	/* registry writes done by the last and all populates */
+	guint registry_writes;
+	guint64 registry_writes_total;
 };
 
 typedef struct _EEeeBackend EEeeBackend;
@@ -111,38 +117,240 @@ eee_backend_queue_auth (EEeeBackend *backend)
 	e_backend_authenticate (E_BACKEND (backend), E_SOURCE_AUTHENTICATOR (backend), NULL, NULL, NULL);
 }
 
+static glong
+eee_backend_parse_perm (const gchar *perm)
+{
+	if (!g_strcmp0 (perm, "read"))
+		return EEE_PERM_READ;
+	else if (!g_strcmp0 (perm, "readwrite"))
+		return EEE_PERM_READWRITE;
+
+	return 0;
+}
+
+static void
+eee_backend_set_user_perms (ESourceEee *extension, GArray *perms)
+{
+	guint j;
+
+	for (j = 0; perms != NULL && j < perms->len; j++) {
+		ESUserPermission *perm = g_array_index (perms, ESUserPermission *, j);
+		glong p = eee_backend_parse_perm (perm->perm);
+
+		if (p != 0)
+			e_source_eee_add_user_perm (extension, perm->user, p);
+	}
+}
+
+static gboolean
+eee_backend_user_perms_equal (ESourceEee *extension, GArray *perms)
+{
+	guint j, count = 0;
+
+	for (j = 0; perms != NULL && j < perms->len; j++) {
+		ESUserPermission *perm = g_array_index (perms, ESUserPermission *, j);
+		glong p = eee_backend_parse_perm (perm->perm);
+
+		if (p == 0)
+			continue;
+		if (e_source_eee_get_user_perm (extension, perm->user) != p)
+			return FALSE;
+		count++;
+	}
+
+	return count == e_source_eee_count_user_perms (extension);
+}
+
+/* Fetch ACLs of one batch of calendars, inserting only those the server
+ * actually returned. Returns FALSE if some of them are missing. */
+static gboolean
+eee_backend_fetch_permissions (xr_client_conn *conn, GArray *calnames, GHashTable *perms)
+{
+	GArray *result;
+	GError *local_error = NULL;
+	gboolean complete = TRUE;
+	guint i;
+
+	result = ESClient_getCalendarsPermissions (conn, calnames, &local_error);
+	if (local_error == NULL) {
+		for (i = 0; i < result->len; i++) {
+			ESCalendarPermissions *info = g_array_index (result, ESCalendarPermissions *, i);
+
+			/* steal perms so that they outlive result */
+			g_hash_table_insert (perms, info->calname, info->perms);
+			info->calname = NULL;
+			info->perms = NULL;
+		}
+		Array_ESCalendarPermissions_free (result);
+	} else if (local_error->code == ES_XMLRPC_ERROR_INVALID_METHOD) {
+		/* older server, ask for each calendar */
+		for (i = 0; i < calnames->len; i++) {
+			gchar *calname = g_array_index (calnames, gchar *, i);
+			GArray *cal_perms = ESClient_getUserPermissions (conn, calname, NULL);
+
+			if (cal_perms)
+				g_hash_table_insert (perms, g_strdup (calname), cal_perms);
+		}
+	} else {
+		g_warning ("eee: failed to get calendar permissions: %s", local_error->message);
+	}
+
+	g_clear_error (&local_error);
+
+	for (i = 0; i < calnames->len; i++) {
+		if (!g_hash_table_contains (perms, g_array_index (calnames, gchar *, i)))
+			complete = FALSE;
+	}
+
+	return complete;
+}
+
+/* Fetch ACLs of all calendars owned by the user, in batches the server
+ * accepts, into hash table calname -> GArray of ESUserPermission. Shared
+ * calendars are skipped, their ACLs can't be changed by the user anyway.
+ * Calendars whose ACLs could not be fetched are left out of the table and
+ * FALSE is returned, so that callers don't mistake them for empty ACLs. */
+static gboolean
+eee_backend_get_permissions (xr_client_conn *conn, GArray *cals, const gchar *username, GHashTable *perms)
+{
+	GArray *calnames;
+	gboolean complete = TRUE;
+	guint i;
+
+	calnames = g_array_new (FALSE, TRUE, sizeof (gchar *));
+	for (i = 0; cals != NULL && i < cals->len; i++) {
+		ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
+		gchar *calname;
+
+		if (g_ascii_strcasecmp (cal->owner, username))
+			continue;
+
+		calname = g_strdup (cal->name);
+		g_array_append_val (calnames, calname);
+
+		if (calnames->len == CALENDARS_PERMISSIONS_MAX) {
+			complete &= eee_backend_fetch_permissions (conn, calnames, perms);
+			Array_string_free (calnames);
+			calnames = g_array_new (FALSE, TRUE, sizeof (gchar *));
+		}
+	}
+
+	if (calnames->len > 0)
+		complete &= eee_backend_fetch_permissions (conn, calnames, perms);
+	Array_string_free (calnames);
+
+	return complete;
+}
+
+/* Update already registered calendar source, touching only properties that
+ * differ from the server. ACL is compared only if perms_known, i.e. it was
+ * really fetched. Returns number of changed properties. */
+static guint
+eee_backend_update_child (ESource *source, ESCalendarInfo *cal, GArray *perms, gboolean perms_known)
+{
+	ESourceExtension *extension;
+	const gchar *title, *color;
+	gchar *old_color;
+	guint writes = 0;
+
+	title = eee_get_attr_value (cal->attrs, "title");
+	if (g_strcmp0 (e_source_get_display_name (source), title ? title : cal->name)) {
+		e_source_set_display_name (source, title ? title : cal->name);
+		writes++;
+	}
+
+	extension = e_source_get_extension (source, E_SOURCE_EXTENSION_CALENDAR);
+	color = eee_get_attr_value (cal->attrs, "color");
+	old_color = e_source_selectable_dup_color (E_SOURCE_SELECTABLE (extension));
+	if (color && g_ascii_strcasecmp (old_color ? old_color : "", color)) {
+		e_source_selectable_set_color (E_SOURCE_SELECTABLE (extension), color);
+		writes++;
+	}
+	g_free (old_color);
+
+	extension = e_source_get_extension (source, E_SOURCE_EXTENSION_EEE);
+	if (perms_known && !eee_backend_user_perms_equal (E_SOURCE_EEE (extension), perms)) {
+		e_source_eee_delete_user_perms (E_SOURCE_EEE (extension));
+		eee_backend_set_user_perms (E_SOURCE_EEE (extension), perms);
+		e_source_eee_notify_user_perms (E_SOURCE_EEE (extension));
+		writes++;
+	}
+
+	return writes;
+}
+
 static void
 eee_backend_get_calendars_list (EEeeBackend *backend, xr_client_conn *conn)
 {
 	ESource *collection_source;
 	ESourceRegistryServer *server;
 	ESourceCollection *collection_extension;
-	const gchar *backend_name;
+	const gchar *backend_name, *username;
 	GArray *cals;
-	guint i;
+	GHashTable *perms;
+	GHashTable *existing;
+	GHashTableIter iter;
+	gpointer value;
+	GList *children, *link;
+	guint i, writes = 0;
 
 	collection_source = e_backend_get_source (E_BACKEND (backend));
 
 	collection_extension = e_source_get_extension (
 		collection_source, E_SOURCE_EXTENSION_COLLECTION);
+	username = e_source_collection_get_identity (collection_extension);
 
 	cals = ESClient_getCalendars (conn, "", NULL);
+	perms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) Array_ESUserPermission_free);
+	if (!eee_backend_get_permissions (conn, cals, username, perms))
+		g_debug ("eee: some ACLs of '%s' were not fetched, keeping them as they are", username);
 
 	backend_name = "eee";
 
 	server = e_collection_backend_ref_server (E_COLLECTION_BACKEND (backend));
 
+	/* calendars already in the registry, by resource id */
+	existing = g_hash_table_new (g_str_hash, g_str_equal);
+	children = e_collection_backend_list_calendar_sources (E_COLLECTION_BACKEND (backend));
+	for (link = children; link; link = link->next) {
+		ESource *child = link->data;
+		ESourceExtension *extension;
+		const gchar *resource_id;
+
+		if (!e_source_has_extension (child, E_SOURCE_EXTENSION_RESOURCE))
+			continue;
+
+		extension = e_source_get_extension (child, E_SOURCE_EXTENSION_RESOURCE);
+		resource_id = e_source_resource_get_identity (E_SOURCE_RESOURCE (extension));
+		if (resource_id)
+			g_hash_table_insert (existing, (gpointer) resource_id, child);
+	}
+
 	for (i = 0; cals != NULL && i < cals->len; i++) {
-		guint j;
 		ESource *source;
 		const gchar *extension_name;
 		ESourceExtension *extension;
 		ESCalendarInfo *cal = g_array_index (cals, ESCalendarInfo *, i);
 		gchar *resource_id;
-		GArray *perms;
+		GArray *cal_perms = NULL;
+		gboolean perms_known = TRUE;
 		const gchar *title, *color;
 
+		if (!g_ascii_strcasecmp (cal->owner, username)) {
+			perms_known = g_hash_table_contains (perms, cal->name);
+			cal_perms = g_hash_table_lookup (perms, cal->name);
+		}
+
 		resource_id = g_strconcat (cal->owner, ":", cal->name, NULL);
+
+		source = g_hash_table_lookup (existing, resource_id);
+		if (source) {
+			writes += eee_backend_update_child (source, cal, cal_perms, perms_known);
+			g_hash_table_remove (existing, resource_id);
+			g_free (resource_id);
+			continue;
+		}
+
 		source = e_collection_backend_new_child (E_COLLECTION_BACKEND (backend), resource_id);
 
 		title = eee_get_attr_value (cal->attrs, "title");
@@ -174,28 +382,37 @@ eee_backend_get_calendars_list (EEeeBackend *backend, xr_client_conn *conn)
 
 		extension_name = E_SOURCE_EXTENSION_EEE;
 		extension = e_source_get_extension (source, extension_name);
-		perms = ESClient_getUserPermissions (conn, cal->name, NULL);
-		for (j = 0; perms != NULL && j < perms->len; j++) {
-			glong p = 0;
-			ESUserPermission *perm = g_array_index (perms, ESUserPermission *, j);
-
-			if (!g_strcmp0 (perm->perm, "read"))
-				p = EEE_PERM_READ;
-			else if (!g_strcmp0 (perm->perm, "readwrite"))
-				p = EEE_PERM_READWRITE;
-			if (p != 0)
-				e_source_eee_add_user_perm (E_SOURCE_EEE (extension), perm->user, p);
-		}
+		eee_backend_set_user_perms (E_SOURCE_EEE (extension), cal_perms);
 
 		e_source_registry_server_add_source (server, source);
+		writes++;
 
 		g_object_unref (source);
 	}
 
+	/* remove calendars that are gone from the server, but only if we
+	 * really got the listing */
+	if (cals != NULL) {
+		g_hash_table_iter_init (&iter, existing);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			e_source_registry_server_remove_source (server, E_SOURCE (value));
+			writes++;
+		}
+	}
+
+	g_hash_table_destroy (existing);
+	g_list_free_full (children, (GDestroyNotify) g_object_unref);
+
 	g_object_unref (server);
 
+	g_hash_table_destroy (perms);
 	Array_ESCalendarInfo_free (cals);
 
+	backend->priv->registry_writes = writes;
+	backend->priv->registry_writes_total += writes;
+	g_debug ("eee: populate of '%s' done with %u registry writes (%" G_GUINT64_FORMAT " total)",
+		username, writes, backend->priv->registry_writes_total);
+
 /*
 	resource_id = GOOGLE_CALENDAR_RESOURCE_ID;
 	source = e_collection_backend_new_child (backend, resource_id);
@@ -629,6 +846,8 @@ e_eee_backend_init (EEeeBackend *backend)
 
 	backend->priv->need_update_calendars = FALSE;
 	backend->priv->password = NULL;
+	backend->priv->registry_writes = 0;
+	backend->priv->registry_writes_total = 0;
 }
 
 static void
@@ -35,6 +35,9 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_CAL_BACKEND_3E, ECalBackend3ePrivate))
 
+/* Size of buffer used to read streamed query results. */
+#define QUERY_STREAM_BUFFER_SIZE (16 * 1024)
+
 #define EDC_ERROR(_code) e_data_cal_create_error (_code, NULL)
 #define EDC_ERROR_EX(_code, _msg) e_data_cal_create_error (_code, _msg)
 
@@ -59,6 +62,7 @@ struct _ECalBackend3ePrivate
     gboolean disposed, updating_source;
     guint refresh_id;
     GTimeVal last_synch;
+    gboolean stream_unsupported;    /* server has no streaming query endpoint */
 };
 
 static void eee_source_changed_cb (ESource *source, ECalBackend3e *cb3e);
@@ -178,9 +182,136 @@ time_to_refresh_eee_calendar_cb (ESource *source,
     g_cond_signal (cb3e->priv->cond);                 
 }
 
+/* Feed one line of streamed iCalendar data to the parser.
+ * Each top-level component of VCALENDAR is parsed as soon as its END line
+ * arrives, so the whole response never has to be held in memory. */
+static void
+stream_parser_add_line (icalcomponent *ical,
+                        GString *comp,
+                        gint *depth,
+                        const gchar *line)
+{
+    if (g_str_has_prefix (line, "BEGIN:"))
+        (*depth)++;
+
+    if (*depth >= 2)
+        g_string_append (comp, line);
+
+    if (g_str_has_prefix (line, "END:")) {
+        if (*depth == 2) {
+            icalcomponent *subcomp = icalcomponent_new_from_string (comp->str);
+
+            if (subcomp)
+                icalcomponent_add_component (ical, subcomp);
+            g_string_truncate (comp, 0);
+        }
+        (*depth)--;
+    }
+}
+
+/* Drop connection whose state is unknown after a failed request, it is
+ * reopened by verify_connection() when needed. */
+static void
+eee_drop_connection (ECalBackend3e *cb3e)
+{
+    if (cb3e->priv->conn) {
+        xr_client_close (cb3e->priv->conn);
+        xr_client_free (cb3e->priv->conn);
+        cb3e->priv->conn = NULL;
+    }
+}
+
+/* Read result of calendar query from the streaming endpoint over the RPC
+ * connection opened by verify_connection(). Returns NULL if the query could
+ * not be streamed. Servers without streaming endpoint are remembered and
+ * never asked again. */
+static icalcomponent *
+eee_stream_server_objects (ECalBackend3e *cb3e,
+                           const char *query)
+{
+    GError *err = NULL;
+    xr_http *http;
+    gchar *calspec, *escaped_query, *resource;
+    gchar buf[QUERY_STREAM_BUFFER_SIZE];
+    gssize bytes_read;
+    GString *line, *comp;
+    gint depth = 0;
+    gint code;
+    icalcomponent *ical = NULL;
+
+    calspec = g_uri_escape_string (cb3e->priv->calspec, NULL, FALSE);
+    escaped_query = g_uri_escape_string (query, NULL, FALSE);
+    resource = g_strdup_printf ("/calendars/%s/objects?query=%s", calspec, escaped_query);
+    g_free (calspec);
+    g_free (escaped_query);
+
+    http = xr_client_get_http (cb3e->priv->conn);
+    xr_http_setup_request (http, "GET", resource, "");
+    g_free (resource);
+    xr_http_set_basic_auth (http, cb3e->priv->username, cb3e->priv->password);
+
+    if (!xr_http_write_header (http, &err) ||
+        !xr_http_write_complete (http, &err) ||
+        !xr_http_read_header (http, &err)) {
+        g_clear_error (&err);
+        eee_drop_connection (cb3e);
+        return NULL;
+    }
+
+    code = xr_http_get_code (http);
+    if (code != 200) {
+        GString *body = xr_http_read_all (http, &err);
+
+        if (body)
+            g_string_free (body, TRUE);
+        if (err) {
+            g_clear_error (&err);
+            eee_drop_connection (cb3e);
+        }
+        if (code == 404 || code == 405 || code == 501)
+            cb3e->priv->stream_unsupported = TRUE;
+        return NULL;
+    }
+
+    ical = icalcomponent_new (ICAL_VCALENDAR_COMPONENT);
+    line = g_string_new (NULL);
+    comp = g_string_new (NULL);
+
+    while ((bytes_read = xr_http_read (http, buf, sizeof (buf), &err)) > 0) {
+        gchar *p = buf, *end = buf + bytes_read, *nl;
+
+        while ((nl = memchr (p, '\n', end - p))) {
+            g_string_append_len (line, p, nl - p + 1);
+            stream_parser_add_line (ical, comp, &depth, line->str);
+            g_string_truncate (line, 0);
+            p = nl + 1;
+        }
+        g_string_append_len (line, p, end - p);
+    }
+
+    if (line->len > 0)
+        stream_parser_add_line (ical, comp, &depth, line->str);
+
+    /* incomplete response, let caller retry the query */
+    if (bytes_read < 0 || err || depth != 0) {
+        g_clear_error (&err);
+        icalcomponent_free (ical);
+        ical = NULL;
+        eee_drop_connection (cb3e);
+    }
+
+    g_string_free (line, TRUE);
+    g_string_free (comp, TRUE);
+
+    return ical;
+}
+
+/* Get objects matching query. Streaming is used only for full fetches, small
+ * incremental queries are cheaper as single RPC call. */
 static icalcomponent *
 eee_get_server_objects (ECalBackend3e *cb3e,
                         const char *query,
+                        gboolean full,
                         GError **perror)
 {
     GError *err = NULL;
@@ -192,6 +323,19 @@ eee_get_server_objects (ECalBackend3e *cb3e,
         return NULL;
     }
 
+    if (full && !cb3e->priv->stream_unsupported && cb3e->priv->conn) {
+        ical = eee_stream_server_objects (cb3e, query);
+        if (ical)
+            return ical;
+
+        /* failed stream may have dropped the connection */
+        if (!verify_connection (cb3e, &err)) {
+            g_propagate_error (perror, err);
+            return NULL;
+        }
+    }
+
+    /* older servers don't have streaming endpoint */
     response = ESClient_queryObjects(cb3e->priv->conn, cb3e->priv->calspec, query, perror);
     if ((perror && *perror) || response == NULL)
         return NULL;
@@ -239,7 +383,8 @@ synchronize_cache (ECalBackend3e *cb3e)
     query = g_strconcat ("modified_since('", tstr, "')", NULL);
     g_free (tstr);
 
-    sobjs = eee_get_server_objects (cb3e, query, NULL);
+    /* nothing synchronized yet, all objects are fetched */
+    sobjs = eee_get_server_objects (cb3e, query, cb3e->priv->last_synch.tv_sec == 0, NULL);
     g_free (query);
 
     if (!sobjs)
@@ -136,8 +136,8 @@ e_source_eee_init (ESourceEee *extension)
 	extension->priv = E_SOURCE_EEE_GET_PRIVATE (extension);
 	extension->priv->property_lock = g_mutex_new ();
 
-	extension->priv->user_perms = g_hash_table_new (g_str_hash, g_str_equal);
-	extension->priv->group_perms = g_hash_table_new (g_str_hash, g_str_equal);
+	extension->priv->user_perms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	extension->priv->group_perms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 void
@@ -155,7 +155,7 @@ e_source_eee_add_user_perm (ESourceEee *extension, const gchar *user, glong perm
 	g_return_if_fail (E_IS_SOURCE_EEE (extension));
 
 	g_mutex_lock (extension->priv->property_lock);
-	g_hash_table_replace (extension->priv->user_perms, (gpointer) user, (gpointer) perm);
+	g_hash_table_replace (extension->priv->user_perms, g_strdup (user), (gpointer) perm);
 	g_mutex_unlock (extension->priv->property_lock);
 }
 
@@ -173,6 +173,20 @@ e_source_eee_get_user_perm (ESourceEee *extension, const gchar *user)
 	return (glong) ret;
 }
 
+guint
+e_source_eee_count_user_perms (ESourceEee *extension)
+{
+	guint ret;
+
+	g_return_val_if_fail (E_IS_SOURCE_EEE (extension), 0);
+
+	g_mutex_lock (extension->priv->property_lock);
+	ret = g_hash_table_size (extension->priv->user_perms);
+	g_mutex_unlock (extension->priv->property_lock);
+
+	return ret;
+}
+
 void
 e_source_eee_delete_user_perms (ESourceEee *extension)
 {
@@ -214,7 +228,7 @@ e_source_eee_add_group_perm (ESourceEee *extension, const gchar *group, glong pe
 	g_return_if_fail (E_IS_SOURCE_EEE (extension));
 
 	g_mutex_lock (extension->priv->property_lock);
-	g_hash_table_replace (extension->priv->group_perms, (gpointer) group, (gpointer) perm);
+	g_hash_table_replace (extension->priv->group_perms, g_strdup (group), (gpointer) perm);
 	g_mutex_unlock (extension->priv->property_lock);
 }
 
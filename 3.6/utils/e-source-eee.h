@@ -64,6 +64,7 @@ void		e_source_eee_type_register	(GTypeModule *type_module);
 
 void e_source_eee_add_user_perm (ESourceEee *extension, const gchar *user, glong perm);
 glong e_source_eee_get_user_perm (ESourceEee *extension, const gchar *user);
+guint e_source_eee_count_user_perms (ESourceEee *extension);
 void e_source_eee_delete_user_perms (ESourceEee *extension);
 void e_source_eee_notify_user_perms (ESourceEee *extension);
 void e_source_eee_foreach_user_perm (ESourceEee *extension, void (*func) (const gchar *name, glong perm));